@@ -19,12 +19,19 @@
 
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 #include <ctype.h>
 #include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
 
 #include "lib_i2c/lib_i2c.h"
 #include "lib_i2cadc.h"
+#include "lib_i2cadc_priv.h"
 
 //------------------------------------------------------------------------------
 //------------------------------------------------------------------------------
@@ -68,347 +75,1572 @@
 //------------------------------------------------------------------------------------------------------------
 #define SWAP_WORD(x)    (((x >> 8) & 0xFF) | ((x << 8) & 0xFF00))
 
-// ADC Reference voltage 5V
-#define ADC_REF_VOLTAGE 5
+// ADC Reference voltage 5V. mV 변환은 board별 calibration table(Q16) 사용. (lib_i2cadc_cal.c)
+// ideal gain = 5000 mV / 4096 = 80000 (Q16)
 
-// Reference 5V, ADC weight value = 1200uV
-#define ADC_WEIGHT_uV   ((ADC_REF_VOLTAGE * 1000000) / 4096)
+// ADC board의 I2C Device addr. 6개의 ltc2309 device가 있음. (기본 board description)
+const unsigned char ADC_I2C_ADDR[] = {
+    0x08, 0x09, 0x0A, 0x0B, 0x18, 0x19
+};
+
+// ADC Channel register address.
+const unsigned char ADC_CH_ADDR[] = {
+    0x88, 0xC8, 0x98, 0xD8, 0xA8, 0xE8, 0xB8, 0xF8
+};
+
+//------------------------------------------------------------------------------
+// Scan item. 요청된 pin은 chip/channel 단위로 모아서(중복 제거) chip 순서로 읽음.
+// idx는 item의 chip/channel index(adc_pin_t)
+//------------------------------------------------------------------------------
+#define SCAN_CH_MAX     (ADC_CHIP_CNT * ADC_CH_CNT)
+
+struct scan_item {
+    unsigned char   adc_idx;
+    unsigned char   ch_idx;
+    unsigned short  idx;
+    unsigned short  raw;
+    unsigned char   flags;          // ADC_FLAG_xxx
+};
+
+//------------------------------------------------------------------------------
+// I2C_RDWR combined transaction buffer. (command write + 2 byte read) message 쌍
+//------------------------------------------------------------------------------
+#define RDWR_XFER_MAX   (I2C_RDWR_IOCTL_MAX_MSGS / 2)
+
+struct rdwr_xfer {
+    struct i2c_msg      msg [RDWR_XFER_MAX * 2];
+    unsigned char       cmd [RDWR_XFER_MAX];
+    unsigned char       buf [RDWR_XFER_MAX][2];
+    struct scan_item    *dst[RDWR_XFER_MAX];
+    int                 cnt;
+};
+
+//------------------------------------------------------------------------------
+// fd API(adc_board_init, adc_board_read)용 fd -> board context registry.
+// 여러 board(fd)를 각각 다른 thread에서 사용할 수 있으므로 검색/등록은 lock으로 보호.
+// registry의 context는 adc_board_deinit(fd)에서 해제됨. deinit 없이 close한 fd 번호가
+// 다시 사용되면 이전 context를 사용중일 수 있으므로 해제하지 않고 등록을 거부함.
+//------------------------------------------------------------------------------
+#define BOARD_MAX       16
+
+static adc_board_t *Boards [BOARD_MAX];
+static pthread_mutex_t BoardsLock = PTHREAD_MUTEX_INITIALIZER;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  unsigned long long  now_ns          (void);
+static  adc_board_t         *board_alloc    (int fd);
+static  void                board_free      (adc_board_t *b);
+static  adc_board_t         *board_register (int fd);
+static  void                board_unregister(adc_board_t *b);
+static  int                 i2cdev_set_addr (void *ctx, unsigned char addr);
+static  int                 i2cdev_read_word(void *ctx, unsigned char cmd);
+static  int                 i2cdev_rdwr     (void *ctx, struct i2c_msg *msg, int nmsgs);
+static  int                 i2cdev_read     (void *ctx, unsigned char *buf, int len);
+static  int                 i2cdev_write    (void *ctx, const unsigned char *buf, int len);
+static  unsigned long       i2cdev_funcs    (void *ctx);
+static  void                i2cdev_close    (void *ctx);
+static  int                 i2cdev_recover  (void *ctx);
+        int                 bus_set_addr    (adc_board_t *b, unsigned char addr);
+        unsigned long       bus_funcs       (adc_board_t *b);
+        int                 bus_read_word   (adc_board_t *b, unsigned char cmd);
+        int                 bus_rdwr        (adc_board_t *b, struct i2c_msg *msg, int nmsgs);
+        int                 bus_read        (adc_board_t *b, unsigned char *buf, int len);
+        int                 bus_write       (adc_board_t *b, const unsigned char *buf, int len);
+        void                chip_set_pend   (adc_board_t *b, int adc_idx, unsigned char cmd,
+                                             unsigned long long ts);
+static  int                 chip_pend_ok    (adc_board_t *b, int adc_idx, unsigned char ch_idx);
+static  unsigned char       mode_cmd        (int ch_idx, int mode);
+static  void                chip_wake       (adc_board_t *b, int mask);
+
+static  int                 read_pin        (adc_board_t *b, adc_pin_t pin, unsigned char *flags);
+static  int                 read_conv       (adc_board_t *b, unsigned char cmd);
+static  int                 read_last       (adc_board_t *b, struct scan_item *item);
+static  int                 scan_chip_smbus (adc_board_t *b, struct scan_item *item, int cnt);
+static  int                 scan_items_smbus(adc_board_t *b, struct scan_item *item, int cnt, int mask);
+static  void                rdwr_add        (struct rdwr_xfer *x, unsigned char addr, unsigned char cmd,
+                                             struct scan_item *dst, int stop);
+static  int                 rdwr_flush      (adc_board_t *b, struct rdwr_xfer *x);
+static  int                 scan_items_rdwr (adc_board_t *b, unsigned long funcs, struct scan_item *item, int cnt,
+                                             unsigned long long *ts);
+static  int                 scan_aligned_smbus (adc_board_t *b, struct scan_item *item, int cnt, int mask,
+                                             unsigned long long *ts);
+static  void                scan_items      (adc_board_t *b, struct scan_item *item, int cnt,
+                                             unsigned long long *ts);
+static  void                scan_channels   (adc_board_t *b, const unsigned char *need, unsigned short *raw,
+                                             unsigned char *flags, unsigned long long *ts);
+static  int                 read_pins       (adc_board_t *b, const adc_pin_t *p, int cnt, int *read_value,
+                                             unsigned char *flags);
+static  int                 scan_oversample (adc_board_t *b, const unsigned char *need, int samples,
+                                             struct adc_stat *stat);
+static  int                 check_devices   (adc_board_t *b);
+
+        adc_board_t *adc_board_open     (const char *i2c_dev_node);
+        adc_board_t *adc_board_open_bus (const struct adc_bus_ops *ops, void *ctx);
+        void adc_board_close    (adc_board_t *b);
+        adc_board_t *adc_board_get      (int fd);
+        int adc_board_fd        (adc_board_t *b);
+        int adc_board_present   (adc_board_t *b);
+        int adc_board_set_conv_age (adc_board_t *b, int age_us);
+        int adc_board_set_mode  (adc_board_t *b, adc_pin_t pin, int mode);
+        int adc_board_get_mode  (adc_board_t *b, adc_pin_t pin);
+        int adc_board_set_sleep (adc_board_t *b, int chip_mask, int refwake_us);
+
+        int adc_pin_resolve     (const char *name, adc_pin_t *pins, int max);
+        int adc_board_read_pin  (adc_board_t *b, adc_pin_t pin);
+        int adc_board_read_many (adc_board_t *b, const adc_pin_t *pins, int n, int *read_value);
+        int adc_board_read_flags(adc_board_t *b, const adc_pin_t *pins, int n, int *read_value,
+                                 unsigned char *flags);
+        int adc_board_read_avg  (adc_board_t *b, const adc_pin_t *pins, int n, int samples,
+                                 int *read_value, struct adc_stat *stat);
+        int adc_board_read_aligned (adc_board_t *b, const adc_pin_t *pins, int n,
+                                 struct adc_aligned *out, unsigned long long *skew_ns);
+        int adc_board_read_raw  (adc_board_t *b, const adc_pin_t *pins, int n, unsigned short *raw);
+        int adc_board_read_raw_flags (adc_board_t *b, const adc_pin_t *pins, int n, unsigned short *raw,
+                                 unsigned char *flags);
+        int adc_board_read_burst(adc_board_t *b, adc_pin_t pin, unsigned short *raw, int n);
+        int adc_board_read_burst_flags (adc_board_t *b, adc_pin_t pin, unsigned short *raw, int n,
+                                 unsigned char *flags);
+        int adc_board_read_name (adc_board_t *b, const char *name, int *read_value, int *cnt);
+        int adc_board_snapshot  (adc_board_t *b, struct adc_snapshot *snap);
+        int adc_snapshot_pin    (const struct adc_snapshot *snap, adc_pin_t pin);
+        int adc_snapshot_read   (const struct adc_snapshot *snap, const char *name, int *read_value, int *cnt);
+        int adc_board_read      (int fd, const char *name, int *read_value, int *cnt);
+        int adc_board_init      (const char *i2c_dev_node);
+        int adc_board_deinit    (int fd);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static unsigned long long now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+// I2C backend : i2c-dev (lib_i2c, /dev/i2c-N). ctx = fd
+//------------------------------------------------------------------------------
+static int i2cdev_set_addr (void *ctx, unsigned char addr)
+{
+    return i2c_set_addr((int)(intptr_t)ctx, addr);
+}
+
+//------------------------------------------------------------------------------
+static int i2cdev_read_word (void *ctx, unsigned char cmd)
+{
+    return i2c_read_word((int)(intptr_t)ctx, cmd);
+}
+
+//------------------------------------------------------------------------------
+static int i2cdev_rdwr (void *ctx, struct i2c_msg *msg, int nmsgs)
+{
+    struct i2c_rdwr_ioctl_data data = { msg, nmsgs };
+
+    return (ioctl((int)(intptr_t)ctx, I2C_RDWR, &data) < 0) ? -1 : 0;
+}
+
+//------------------------------------------------------------------------------
+static int i2cdev_read (void *ctx, unsigned char *buf, int len)
+{
+    return (read((int)(intptr_t)ctx, buf, len) != len) ? -1 : 0;
+}
+
+//------------------------------------------------------------------------------
+static int i2cdev_write (void *ctx, const unsigned char *buf, int len)
+{
+    return (write((int)(intptr_t)ctx, buf, len) != len) ? -1 : 0;
+}
+
+//------------------------------------------------------------------------------
+static unsigned long i2cdev_funcs (void *ctx)
+{
+    unsigned long funcs;
+
+    return (ioctl((int)(intptr_t)ctx, I2C_FUNCS, &funcs) < 0) ? 0 : funcs;
+}
+
+//------------------------------------------------------------------------------
+static void i2cdev_close (void *ctx)
+{
+    close ((int)(intptr_t)ctx);
+}
+
+//------------------------------------------------------------------------------
+// i2c-dev에는 user space bus recovery(clock-out) ioctl이 없으므로 stuck SDA를 해제할 수 없음.
+// SCL clock-out(9 clock + STOP)은 adapter driver가 bus busy/timeout시 처리(i2c_recover_bus)함.
+// device node를 다시 open하여 같은 fd 번호로 교체(dup2)하면 I2C_SLAVE 등 client 상태만
+// 초기화되므로 recovery는 항상 실패(-1)로 처리함. (bus_recover가 cache 상태는 초기화)
+//------------------------------------------------------------------------------
+static int i2cdev_recover (void *ctx)
+{
+    int fd = (int)(intptr_t)ctx, nfd, len;
+    char path [64], node [256];
+
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    if ((len = readlink(path, node, sizeof(node) - 1)) <= 0)
+        return -1;
+    node[len] = 0;
+
+    if ((nfd = open(node, O_RDWR)) < 0)
+        return -1;
+
+    dup2(nfd, fd);
+    close (nfd);
+    return -1;
+}
+
+static const struct adc_bus_ops I2cDevBus = {
+    "i2c-dev",
+    i2cdev_set_addr,
+    i2cdev_read_word,
+    i2cdev_rdwr,
+    i2cdev_read,
+    i2cdev_write,
+    i2cdev_funcs,
+    i2cdev_close,
+    i2cdev_recover,
+};
+
+//------------------------------------------------------------------------------
+static adc_board_t *board_alloc (int fd)
+{
+    adc_board_t *b;
+    int i;
+
+    if ((b = calloc(1, sizeof(adc_board_t))) == NULL)
+        return NULL;
+
+    b->fd          = fd;
+    b->ops         = &I2cDevBus;
+    b->bus_ctx     = (void *)(intptr_t)fd;
+    b->addr        = -1;
+    b->chips       = (1 << desc_chips (b->chip_addr)) - 1;
+    b->present     = b->chips;
+    b->conv_age_ns = ADC_CONV_AGE_US * 1000ULL;
+    b->refwake_ns  = ADC_REFWAKE_US * 1000ULL;
+    memcpy(b->cmd, ADC_CH_ADDR, ADC_CH_CNT);
+    for (i = 1; i < ADC_CHIP_CNT; i++)
+        memcpy(&b->cmd[i * ADC_CH_CNT], ADC_CH_ADDR, ADC_CH_CNT);
+    cal_reset (&b->cal);
+    recover_init (b);
+    pthread_mutex_init(&b->lock, NULL);
+    return b;
+}
+
+//------------------------------------------------------------------------------
+static void board_free (adc_board_t *b)
+{
+    pthread_mutex_destroy(&b->lock);
+    free (b);
+}
+
+//------------------------------------------------------------------------------
+// fd의 새로운 context를 registry에 등록함.
+// 같은 fd의 context가 남아있으면 adc_board_deinit 없이 close된 fd이며, 다른 thread
+// (sampler, async 등)가 아직 사용중일 수 있으므로 해제하지 않고 거부함.
+// return NULL : registry full 또는 이미 등록된 fd
+//------------------------------------------------------------------------------
+static adc_board_t *board_register (int fd)
+{
+    adc_board_t *b;
+    int i, slot = -1, stale = 0;
+
+    if ((b = board_alloc (fd)) == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&BoardsLock);
+    for (i = 0; i < BOARD_MAX; i++) {
+        if (Boards[i] && (Boards[i]->fd == fd)) {
+            stale = 1;
+            break;
+        }
+        if (!Boards[i] && (slot < 0))
+            slot = i;
+    }
+    if (!stale && (slot >= 0))
+        Boards[slot] = b;
+    pthread_mutex_unlock(&BoardsLock);
+
+    if (stale || (slot < 0)) {
+        fprintf(stderr, "%s : fd %d %s\n", __func__, fd,
+            stale ? "is still registered (closed without adc_board_deinit)" : "registry full");
+        board_free (b);
+        return NULL;
+    }
+    return b;
+}
+
+//------------------------------------------------------------------------------
+// registry에서 제거 후 해제함. (adc_board_init에서 probe 실패시)
+//------------------------------------------------------------------------------
+static void board_unregister (adc_board_t *b)
+{
+    int i;
+
+    pthread_mutex_lock(&BoardsLock);
+    for (i = 0; i < BOARD_MAX; i++) {
+        if (Boards[i] == b) {
+            Boards[i] = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&BoardsLock);
+
+    board_free (b);
+}
+
+//------------------------------------------------------------------------------
+// slave address가 변경되는 경우에만 i2c_set_addr(I2C_SLAVE ioctl)를 호출함.
+// 실패시 retry는 호출자(scan_items_smbus)가 chip 단위로 처리함. return 0 : success, -1 : fail
+//------------------------------------------------------------------------------
+int bus_set_addr (adc_board_t *b, unsigned char addr)
+{
+    int ret;
+    STAT_VAR(t0);
+
+    if (b->addr == addr)
+        return 0;
+
+    STAT_BEGIN(t0);
+    ret = b->ops->set_addr(b->bus_ctx, addr) ? -1 : 0;
+    STAT_END(b, ADC_OP_SET_ADDR, t0, addr, 0, 0, ret);
+
+    b->addr = ret ? -1 : addr;
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+// adapter 지원 기능(I2C_FUNCS). board별로 1회만 확인함.
+//------------------------------------------------------------------------------
+unsigned long bus_funcs (adc_board_t *b)
+{
+    if (!b->funcs && !(b->funcs = b->ops->funcs(b->bus_ctx)))
+        b->funcs = I2C_FUNC_SMBUS_READ_WORD_DATA;
+
+    return b->funcs;
+}
+
+//------------------------------------------------------------------------------
+// Bus access. 모든 transaction은 아래 함수를 통해 전달됨. (통계 : __LIB_I2CADC_STATS__)
+//------------------------------------------------------------------------------
+// SMBus read word (command write + 2 byte read). return : read_word 값, < 0 : error
+//------------------------------------------------------------------------------
+int bus_read_word (adc_board_t *b, unsigned char cmd)
+{
+    int ret;
+    STAT_VAR(t0);
+
+    STAT_BEGIN(t0);
+    ret = b->ops->read_word(b->bus_ctx, cmd);
+    STAT_END(b, ADC_OP_SMBUS, t0, b->addr, 1, 3, (ret < 0));
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+// I2C_RDWR combined transaction. return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+int bus_rdwr (adc_board_t *b, struct i2c_msg *msg, int nmsgs)
+{
+    int ret;
+    STAT_VAR(t0);
+
+    STAT_BEGIN(t0);
+    ret = b->ops->rdwr(b->bus_ctx, msg, nmsgs) ? -1 : 0;
+    STAT_RDWR(b, t0, msg, nmsgs, ret);
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+// plain i2c read/write (I2C_SLAVE로 설정된 chip). return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+int bus_read (adc_board_t *b, unsigned char *buf, int len)
+{
+    int ret;
+    STAT_VAR(t0);
+
+    STAT_BEGIN(t0);
+    ret = b->ops->read(b->bus_ctx, buf, len) ? -1 : 0;
+    STAT_END(b, ADC_OP_PLAIN, t0, b->addr, 1, len, ret);
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+int bus_write (adc_board_t *b, const unsigned char *buf, int len)
+{
+    int ret;
+    STAT_VAR(t0);
+
+    STAT_BEGIN(t0);
+    ret = b->ops->write(b->bus_ctx, buf, len) ? -1 : 0;
+    STAT_END(b, ADC_OP_PLAIN, t0, b->addr, 1, len, ret);
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+// chip에 마지막으로 전달된 command를 기록함. ts = 해당 transaction(STOP) 시간
+//------------------------------------------------------------------------------
+void chip_set_pend (adc_board_t *b, int adc_idx, unsigned char cmd, unsigned long long ts)
+{
+    b->pend_cmd [adc_idx] = cmd;
+    b->pend_ns  [adc_idx] = ts;
+}
+
+//------------------------------------------------------------------------------
+// chip에서 ch_idx의 conversion이 진행(완료)되어 있고 conv_age_ns 이내인지 확인.
+// LTC2309는 conversion 후 결과를 유지(nap)하므로 dummy read 없이 바로 읽을 수 있음.
+//------------------------------------------------------------------------------
+static int chip_pend_ok (adc_board_t *b, int adc_idx, unsigned char ch_idx)
+{
+    if (!b->conv_age_ns || (b->pend_cmd [adc_idx] != CH_CMD(b, adc_idx, ch_idx)))
+        return 0;
+
+    return (now_ns() - b->pend_ns [adc_idx]) <= b->conv_age_ns;
+}
+
+//------------------------------------------------------------------------------
+// channel input mode의 LTC2309 command. (S/D, O/S, S1, S0, UNI)
+// differential은 O/S로 channel 쌍의 극성을 선택하므로 IN+ = ch_idx, IN- = ch_idx ^ 1
+//------------------------------------------------------------------------------
+static unsigned char mode_cmd (int ch_idx, int mode)
+{
+    unsigned char cmd = ((ch_idx & 1) ? ADC_CMD_OS : 0) | ((ch_idx >> 1) << 4);
+
+    cmd |= (mode & ADC_MODE_DIFF)    ? 0 : ADC_CMD_SD;
+    cmd |= (mode & ADC_MODE_BIPOLAR) ? 0 : ADC_CMD_UNI;
+    return cmd;
+}
+
+//------------------------------------------------------------------------------
+// scan할 chip(mask) 중 sleep 상태인 chip을 깨움.
+// SLP = 0인 command를 받으면 sleep에서 나오지만 reference가 안정(tREFWAKE)되기 전의
+// conversion은 사용할 수 없으므로, 모든 chip을 먼저 깨우고 1회만 기다린 후 dummy read
+// 부터 다시 시작함. (chip별로 기다리면 scan 시간이 chip 수만큼 늘어남)
+//------------------------------------------------------------------------------
+static void chip_wake (adc_board_t *b, int mask)
+{
+    unsigned long long wake;
+    struct timespec ts;
+    int c;
+
+    if (!(mask &= b->sleeping))
+        return;
+
+    for (c = 0; c < ADC_CHIP_CNT; c++) {
+        if (!(mask & (1 << c)))
+            continue;
+        if (bus_set_addr(b, b->chip_addr [c]) || (bus_read_word(b, CH_CMD(b, c, 0)) < 0))
+            continue;
+        b->sleeping &= ~(1 << c);
+        chip_set_pend (b, c, 0, 0);
+    }
+
+    wake = now_ns() + b->refwake_ns;
+    ts.tv_sec  = wake / 1000000000ULL;
+    ts.tv_nsec = wake % 1000000000ULL;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+//------------------------------------------------------------------------------
+// pin의 raw값을 읽어옴. flags에 ADC_FLAG_xxx를 저장함. (NC pin = 0)
+//------------------------------------------------------------------------------
+static int read_pin (adc_board_t *b, adc_pin_t pin, unsigned char *flags)
+{
+    struct scan_item item;
+
+    *flags = 0;
+    if (pin == ADC_PIN_NC)
+        return 0;
+
+    item.adc_idx = pin / ADC_CH_CNT;
+    item.ch_idx  = pin % ADC_CH_CNT;
+    item.idx     = pin;
+
+    // 같은 channel의 conversion이 진행중이면 dummy read 없이 1회 read
+    scan_items (b, &item, 1, NULL);
+    *flags = item.flags;
+    return item.raw;
+}
+
+//------------------------------------------------------------------------------
+// 현재 선택된 chip에 command(cmd)를 전달하고 이전 conversion 결과를 읽어옴.
+// read 후 STOP에서 새로운 command로 다음 conversion이 시작됨. return < 0 : error
+//------------------------------------------------------------------------------
+static int read_conv (adc_board_t *b, unsigned char cmd)
+{
+    int read_val = bus_read_word(b, cmd);
+
+    return (read_val < 0) ? -1 : (SWAP_WORD (read_val) >> 4) & 0xFFF;
+}
+
+//------------------------------------------------------------------------------
+// chip의 마지막 channel 결과를 읽어옴. 같은 command를 다시 보내므로 read 후 해당 channel의
+// conversion이 진행중인 상태로 기록함. (read 실패시 알 수 없음)
+// sleep 설정된 chip은 SLP bit를 추가하여 마지막 conversion 후 sleep으로 들어가게 함.
+// return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+static int read_last (adc_board_t *b, struct scan_item *item)
+{
+    unsigned char cmd = CH_CMD(b, item->adc_idx, item->ch_idx);
+    int read_val;
+
+    if (b->sleep_mask & (1 << item->adc_idx))
+        cmd |= ADC_CMD_SLP;
+
+    read_val  = bus_read_word(b, cmd);
+    item->raw = (read_val < 0) ? 0 : (SWAP_WORD (read_val) >> 4) & 0xFFF;
+    chip_set_pend (b, item->adc_idx, (read_val < 0) ? 0 : cmd, now_ns());
+    return (read_val < 0) ? -1 : 0;
+}
+
+//------------------------------------------------------------------------------
+// Pipelined scan(SMBus). 1개 chip의 item[cnt]을 읽음. (item은 모두 같은 chip)
+// LTC2309는 read시 이전 conversion 결과를 출력하면서 새로 받은 command로 다음
+// conversion을 시작함. 다음 channel의 command를 보내면서 현재 channel의 결과를 읽어오면
+// 같은 chip의 channel은 channel당 1회의 transaction으로 처리됨.
+// chip당 1회 address 변경 및 dummy read(첫 conversion 시작)를 진행하며,
+// 첫 channel의 conversion이 이미 진행중이면 dummy read도 생략함.
+// return 0 : success, -1 : error (pipeline이 끊어지므로 chip의 모든 item이 유효하지 않음)
+//------------------------------------------------------------------------------
+static int scan_chip_smbus (adc_board_t *b, struct scan_item *item, int cnt)
+{
+    int i, raw, c = item[0].adc_idx;
+
+    if (bus_set_addr(b, b->chip_addr [c]))
+        goto err;
+    if (!chip_pend_ok (b, c, item[0].ch_idx) && (read_conv(b, CH_CMD(b, c, item[0].ch_idx)) < 0))
+        goto err;
+
+    for (i = 1; i < cnt; i++) {
+        if ((raw = read_conv(b, CH_CMD(b, c, item[i].ch_idx))) < 0)
+            goto err;
+        item[i - 1].raw = raw;
+    }
+    if (!read_last (b, &item[cnt - 1]))
+        return 0;
+err:
+    chip_set_pend (b, c, 0, 0);
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+// SMBus scan. (item은 chip별로 모여 있어야 함) mask의 chip을 chip 단위로 1회씩 읽은 후
+// 실패한 chip만 backoff 간격(2배씩 증가)으로 retry_max회까지 다시 읽음.
+// retry는 sleep 하지 않으며 backoff 시간이 지난 chip만 deadline(첫 retry부터 budget_us)
+// 이내에서 진행함. (retry할 chip이 없으면 종료, 남은 chip은 다음 scan에서 다시 읽음)
+// scan한 모든 chip이 실패하는 경우(SDA stuck 등)는 bus recovery 후 1회 더 읽음.
+// 실패한 chip의 item은 ADC_FLAG_ERR (값 0), retry 후 성공한 chip은 ADC_FLAG_RETRY
+// return : 실패한 chip (bit = chip index)
+//------------------------------------------------------------------------------
+static int scan_items_smbus (adc_board_t *b, struct scan_item *item, int cnt, int mask)
+{
+    unsigned long long deadline = 0, now;
+    unsigned long long due [ADC_CHIP_CNT], backoff [ADC_CHIP_CNT];
+    int first [ADC_CHIP_CNT], end [ADC_CHIP_CNT], retry [ADC_CHIP_CNT];
+    int i, j, c, pass, ret, progress, scanned = 0, failed = 0;
+
+    for (c = 0; c < ADC_CHIP_CNT; c++)
+        first[c] = end[c] = -1, retry[c] = 0;
+
+    for (i = 0; i < cnt; i = j) {
+        c = item[i].adc_idx;
+        for (j = i + 1; (j < cnt) && (item[j].adc_idx == c); j++)
+            ;
+        first[c] = i, end[c] = j;
+    }
+
+    for (pass = 0; pass < 2; pass++) {
+        // mask의 chip을 1회씩 읽음
+        for (c = 0; c < ADC_CHIP_CNT; c++) {
+            if ((first[c] < 0) || !(mask & (1 << c)))
+                continue;
+
+            scanned   |= 1 << c;
+            retry  [c] = 0;
+            backoff[c] = b->rec.cfg.backoff_us * 1000ULL;
+            if (scan_chip_smbus (b, &item[first[c]], end[c] - first[c])) {
+                failed |= 1 << c;
+                due [c] = now_ns() + backoff[c];
+            }
+            else
+                failed &= ~(1 << c);
+        }
+
+        // 실패한 chip retry. 다른 chip을 읽는 시간이 backoff가 되며 제한 시간은 첫 retry부터
+        if (failed && !deadline)
+            deadline = recover_deadline (b);
+        do {
+            now = now_ns();
+            for (c = 0, progress = 0; c < ADC_CHIP_CNT; c++) {
+                if (!(failed & (1 << c)) || (retry[c] >= b->rec.cfg.retry_max))
+                    continue;
+                if ((ret = recover_retry (b, now, deadline, due[c], &backoff[c])) <= 0) {
+                    if (ret < 0)
+                        retry[c] = b->rec.cfg.retry_max;
+                    continue;
+                }
+                retry[c]++, progress = 1;
+                if (scan_chip_smbus (b, &item[first[c]], end[c] - first[c]))
+                    due[c] = (now = now_ns()) + backoff[c];
+                else
+                    failed &= ~(1 << c);
+            }
+        } while (progress && failed);
+
+        // 실패한 chip만 다시 읽음
+        if (pass || !recover_bus_stuck (b, scanned, failed) || bus_recover (b))
+            break;
+        mask = failed;
+    }
+
+    for (c = 0; c < ADC_CHIP_CNT; c++) {
+        if ((first[c] < 0) || !(scanned & (1 << c)))
+            continue;
+        for (i = first[c]; i < end[c]; i++) {
+            item[i].raw   = (failed & (1 << c)) ? 0 : item[i].raw;
+            item[i].flags = (failed & (1 << c)) ? ADC_FLAG_ERR : (retry[c] ? ADC_FLAG_RETRY : 0);
+        }
+    }
+    return failed;
+}
+
+//------------------------------------------------------------------------------
+// transaction(command write + 2 byte read) 추가. dst == NULL이면 결과를 버림(dummy read)
+//------------------------------------------------------------------------------
+static void rdwr_add (struct rdwr_xfer *x, unsigned char addr, unsigned char cmd,
+                      struct scan_item *dst, int stop)
+{
+    struct i2c_msg *m = &x->msg[x->cnt * 2];
+
+    x->cmd[x->cnt] = cmd;
+    x->dst[x->cnt] = dst;
+
+    m[0].addr  = addr;
+    m[0].flags = 0;
+    m[0].len   = 1;
+    m[0].buf   = &x->cmd[x->cnt];
+    m[1].addr  = addr;
+    m[1].flags = I2C_M_RD | (stop ? I2C_M_STOP : 0);
+    m[1].len   = 2;
+    m[1].buf   = x->buf[x->cnt];
+    x->cnt++;
+}
+
+//------------------------------------------------------------------------------
+static int rdwr_flush (adc_board_t *b, struct rdwr_xfer *x)
+{
+    int i;
+
+    if (!x->cnt)
+        return 0;
+
+    if (bus_rdwr (b, x->msg, x->cnt * 2))
+        return -1;
+
+    for (i = 0; i < x->cnt; i++)
+        if (x->dst[i])
+            x->dst[i]->raw = ((x->buf[i][0] << 8 | x->buf[i][1]) >> 4) & 0xFFF;
+    x->cnt = 0;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// I2C_RDWR combined transaction scan. (item은 chip별로 모여 있어야 함)
+// chip별 (command write + 2 byte read) message 쌍을 하나의 ioctl로 묶어서 전달함.
+//
+// LTC2309는 STOP condition에서 conversion을 시작하므로, repeated START로 이어지는
+// 하나의 ioctl 안에서는 chip당 1개의 transaction만 보낼 수 있음. 따라서 각 chip의
+// n번째 transaction을 모아서 1회의 ioctl(round)로 처리하며, 마지막 STOP에서 모든 chip이
+// 동시에 다음 conversion을 시작함. (보드 전체 = 9 round/ioctl)
+// adapter가 I2C_FUNC_PROTOCOL_MANGLING을 지원하는 경우 read message마다 I2C_M_STOP을
+// 설정하여 ioctl 1회에 최대 RDWR_XFER_MAX개의 transaction을 전달함.
+// chip의 첫 channel conversion이 이미 진행중이면 해당 chip의 dummy read를 생략함.
+//
+// ts != NULL이면 burst-aligned scan. round마다 ioctl을 전송하여(I2C_M_STOP 사용 안함)
+// 모든 chip이 ioctl의 마지막 STOP에서 동시에 conversion을 시작하도록 하고, item의 conversion
+// 시작 시간(command를 보낸 round의 ioctl 완료 시간)을 ts[item]에 저장함. (dummy read 생략 안함)
+//
+// return 0 : success, -1 : ioctl fail (호출자가 SMBus 방식으로 다시 읽음)
+//------------------------------------------------------------------------------
+static int scan_items_rdwr (adc_board_t *b, unsigned long funcs, struct scan_item *item, int cnt,
+                            unsigned long long *ts)
+{
+    struct rdwr_xfer x;
+    // chip별 다음 command를 보낼 item, 결과를 기다리는 item, chip item 범위의 끝,
+    // 이번 round에서 command를 보낸 item
+    int next [ADC_CHIP_CNT], pend [ADC_CHIP_CNT], end [ADC_CHIP_CNT], sent [ADC_CHIP_CNT];
+    int i, c, remain = 0, err = 0, stop = (!ts && (funcs & I2C_FUNC_PROTOCOL_MANGLING)) ? 1 : 0;
+    // 마지막 conversion 시작 시간은 scan 시작 시간으로 기록 (실제보다 오래된 것으로 처리)
+    unsigned long long t, ts_scan = now_ns();
+
+    for (c = 0; c < ADC_CHIP_CNT; c++)
+        next[c] = pend[c] = end[c] = -1;
+
+    for (i = 0; i < cnt; i++) {
+        // 없는 chip, 격리된 chip의 channel은 0으로 처리
+        if (!CHIP_ACTIVE(b, item[i].adc_idx))
+            continue;
+        if (next[item[i].adc_idx] < 0)
+            next[item[i].adc_idx] = i, remain++;
+        end[item[i].adc_idx] = i + 1;
+    }
+
+    for (c = 0; c < ADC_CHIP_CNT; c++) {
+        if (ts || (next[c] < 0) || !chip_pend_ok (b, c, item[next[c]].ch_idx))
+            continue;
+        pend[c] = next[c]++;
+        if (next[c] >= end[c])
+            next[c] = -1;
+    }
+
+    x.cnt = 0;
+    while (remain && !err) {
+        for (c = 0; c < ADC_CHIP_CNT; c++) {
+            sent[c] = -1;
+            if (next[c] < 0 && pend[c] < 0)
+                continue;
+
+            if ((x.cnt == RDWR_XFER_MAX) && (err = rdwr_flush (b, &x)))
+                break;
+
+            // 보낼 command가 없으면 결과 대기중인 channel의 command를 다시 보냄(마지막 read)
+            // sleep 설정된 chip은 마지막 command에 SLP bit를 추가함.
+            i = (next[c] >= 0) ? next[c] : pend[c];
+            rdwr_add (&x, b->chip_addr [c], CH_CMD(b, c, item[i].ch_idx) |
+                      (((next[c] < 0) && (b->sleep_mask & (1 << c))) ? ADC_CMD_SLP : 0),
+                      (pend[c] >= 0) ? &item[pend[c]] : NULL, stop);
+
+            if (next[c] < 0) {
+                pend[c] = -1, remain--;
+                continue;
+            }
+            sent[c] = next[c];
+            pend[c] = next[c]++;
+            if (next[c] >= end[c])
+                next[c] = -1;
+        }
+        // I2C_M_STOP을 사용할 수 없으면 round마다 ioctl 전송
+        if (!err && (!stop || !remain))
+            err = rdwr_flush (b, &x);
+
+        if (ts && !err) {
+            t = now_ns();
+            for (c = 0; c < ADC_CHIP_CNT; c++)
+                if (sent[c] >= 0)
+                    ts[sent[c]] = t;
+        }
+    }
+
+    // chip별 마지막 command 기록. 일부 round만 전달된 경우(err) chip의 상태를 알 수 없음
+    for (c = 0; c < ADC_CHIP_CNT; c++)
+        if (end[c] > 0)
+            chip_set_pend (b, c, err ? 0 : CH_CMD(b, c, item[end[c] -1].ch_idx) |
+                           ((b->sleep_mask & (1 << c)) ? ADC_CMD_SLP : 0), ts_scan);
+
+    return err;
+}
+
+//------------------------------------------------------------------------------
+// Burst-aligned scan(SMBus). scan_items_rdwr와 같은 round 순서(각 chip의 n번째 item)로
+// chip별 read_word를 연속으로 보내며, item의 conversion 시작 시간(command를 보낸
+// transaction의 완료 시간)을 ts[item]에 저장함. chip 간 skew는 round 안의 transaction 수만큼
+// 생기며 retry는 하지 않음. (retry하면 해당 chip의 시간이 어긋남)
+// return : 실패한 chip (bit = chip index), 실패한 chip의 item은 ADC_FLAG_ERR (값 0)
+//------------------------------------------------------------------------------
+static int scan_aligned_smbus (adc_board_t *b, struct scan_item *item, int cnt, int mask,
+                               unsigned long long *ts)
+{
+    int first [ADC_CHIP_CNT], next [ADC_CHIP_CNT], pend [ADC_CHIP_CNT], end [ADC_CHIP_CNT];
+    int i, c, raw, remain = 0, failed = 0;
+    unsigned char cmd;
+
+    for (c = 0; c < ADC_CHIP_CNT; c++)
+        first[c] = next[c] = pend[c] = end[c] = -1;
+
+    for (i = 0; i < cnt; i++) {
+        if (!(mask & (1 << item[i].adc_idx)))
+            continue;
+        if (next[item[i].adc_idx] < 0)
+            first[item[i].adc_idx] = next[item[i].adc_idx] = i, remain++;
+        end[item[i].adc_idx] = i + 1;
+    }
+
+    while (remain) {
+        for (c = 0; c < ADC_CHIP_CNT; c++) {
+            if (next[c] < 0 && pend[c] < 0)
+                continue;
+
+            // 보낼 command가 없으면 결과 대기중인 channel의 command를 다시 보냄(마지막 read)
+            i   = (next[c] >= 0) ? next[c] : pend[c];
+            cmd = CH_CMD(b, c, item[i].ch_idx) |
+                  (((next[c] < 0) && (b->sleep_mask & (1 << c))) ? ADC_CMD_SLP : 0);
+
+            if (bus_set_addr(b, b->chip_addr [c]) || ((raw = read_conv(b, cmd)) < 0)) {
+                for (i = first[c]; i < end[c]; i++)
+                    if (item[i].adc_idx == c)
+                        item[i].raw = 0, item[i].flags = ADC_FLAG_ERR;
+                chip_set_pend (b, c, 0, 0);
+                failed |= 1 << c;
+                next[c] = pend[c] = -1, remain--;
+                continue;
+            }
+            if (pend[c] >= 0)
+                item[pend[c]].raw = raw;
+
+            if (next[c] < 0) {
+                chip_set_pend (b, c, cmd, now_ns());
+                pend[c] = -1, remain--;
+                continue;
+            }
+            ts[next[c]] = now_ns();
+            pend[c] = next[c]++;
+            if (next[c] >= end[c])
+                next[c] = -1;
+        }
+    }
+    return failed;
+}
+
+//------------------------------------------------------------------------------
+// adapter가 I2C_FUNC_I2C(plain i2c transaction)를 지원하면 I2C_RDWR 방식으로 읽고,
+// 지원하지 않거나 실패하는 경우 SMBus(i2c_read_word) 방식으로 읽음.
+//
+// channel mode는 command에만 반영되므로 mode가 다른 channel이 섞여 있어도 chip 단위의
+// pipeline(다음 command + 현재 결과 read)은 그대로 유지됨. SLP command는 chip의 마지막
+// transaction에만 사용하며, sleep 중인 chip은 scan 전에 한번에 깨움.
+//
+// 없는 chip, 격리된 chip은 읽지 않으며 결과는 item.flags(ADC_FLAG_xxx)에 저장함.
+// I2C_RDWR는 1개 chip의 NAK에도 ioctl 전체가 실패하므로 SMBus 방식에서 chip별로 retry 하고
+// 계속 실패하는 chip은 격리되어 다음 scan부터 I2C_RDWR 방식으로 다시 읽음.
+//
+// ts != NULL이면 burst-aligned scan. (item별 conversion 시작 시간, 읽지 않은 item = 0)
+//------------------------------------------------------------------------------
+static void scan_items (adc_board_t *b, struct scan_item *item, int cnt, unsigned long long *ts)
+{
+    unsigned long funcs = bus_funcs (b);
+    int i, mask = 0, failed = 0;
+
+    for (i = 0; i < cnt; i++)
+        mask |= CHIP_PRESENT(b, item[i].adc_idx) ? (1 << item[i].adc_idx) : 0;
+
+    // 확인 시간이 된 격리 chip을 확인한 후 scan할 chip
+    mask = recover_begin (b, mask);
+
+    for (i = 0; i < cnt; i++) {
+        item[i].raw   = 0;
+        item[i].flags = !CHIP_PRESENT(b, item[i].adc_idx) ? ADC_FLAG_ABSENT :
+                        !CHIP_ACTIVE(b, item[i].adc_idx)  ? ADC_FLAG_ISOLATED : 0;
+        if (ts)
+            ts[i] = 0;
+    }
+
+    chip_wake (b, mask);
+
+    if (!(funcs & I2C_FUNC_I2C) || scan_items_rdwr (b, funcs, item, cnt, ts))
+        failed = ts ? scan_aligned_smbus (b, item, cnt, mask, ts) : scan_items_smbus (b, item, cnt, mask);
+
+    recover_end (b, mask, failed);
+
+    // bipolar channel은 2의 보수(12 bits)를 sign-extend
+    for (i = 0; i < cnt; i++)
+        if ((b->mode [item[i].idx] & ADC_MODE_BIPOLAR) && !(item[i].flags & ADC_FLAG_INVALID))
+            item[i].raw = RAW_SEXT12(item[i].raw);
+
+    b->sleeping |= mask & ~failed & b->sleep_mask;
+}
+
+//------------------------------------------------------------------------------
+// Scan planner. need[chip/channel]이 설정된 channel을 chip/channel 순서로 한번씩 읽어서
+// raw[chip/channel]에 저장함. (chip별 1회 address 설정 + channel당 1회 transaction)
+// flags != NULL이면 flags[chip/channel]에 ADC_FLAG_xxx를 저장함. (읽지 않은 channel = 0)
+// ts != NULL이면 burst-aligned scan으로 읽고 ts[chip/channel]에 conversion 시작 시간을 저장함.
+//------------------------------------------------------------------------------
+static void scan_channels (adc_board_t *b, const unsigned char *need, unsigned short *raw,
+                           unsigned char *flags, unsigned long long *ts)
+{
+    struct scan_item item [SCAN_CH_MAX];
+    unsigned long long item_ts [SCAN_CH_MAX];
+    int i, n;
+
+    if (flags)
+        memset(flags, 0, SCAN_CH_MAX);
+    if (ts)
+        memset(ts, 0, sizeof(unsigned long long) * SCAN_CH_MAX);
+
+    for (i = 0, n = 0; i < SCAN_CH_MAX; i++) {
+        raw[i] = 0;
+        if (!need[i])
+            continue;
+        item[n].adc_idx = i / ADC_CH_CNT;
+        item[n].ch_idx  = i % ADC_CH_CNT;
+        item[n].idx     = i;
+        n++;
+    }
+    scan_items (b, item, n, ts ? item_ts : NULL);
+
+    while (n--) {
+        raw[item[n].idx] = item[n].raw;
+        if (flags)
+            flags[item[n].idx] = item[n].flags;
+        if (ts)
+            ts[item[n].idx] = item_ts[n];
+    }
+}
+
+//------------------------------------------------------------------------------
+// Multi-pin read. pin이 사용하는 chip/channel을 한번씩 읽은 후
+// 결과(raw)와 ADC_FLAG_xxx는 호출자의 pin 순서로 read_value, flags에 저장함.
+//------------------------------------------------------------------------------
+static int read_pins (adc_board_t *b, const adc_pin_t *p, int cnt, int *read_value,
+                      unsigned char *flags)
+{
+    unsigned char need [SCAN_CH_MAX], ch_flags [SCAN_CH_MAX];
+    unsigned short raw [SCAN_CH_MAX];
+    int i;
+
+    memset(need, 0, sizeof(need));
+    for (i = 0; i < cnt; i++)
+        if (p[i] != ADC_PIN_NC)
+            need[p[i]] = 1;
+
+    scan_channels (b, need, raw, ch_flags, NULL);
 
-enum {
-    CHIP_ADC0 = 0,
-    CHIP_ADC1,
-    CHIP_ADC2,
-    CHIP_ADC3,
-    CHIP_ADC4,
-    CHIP_ADC5,
-    NOT_USED,
-};
+    for (i = 0; i < cnt; i++) {
+        read_value[i] = (p[i] == ADC_PIN_NC) ? 0 : raw[p[i]];
+        flags[i]      = (p[i] == ADC_PIN_NC) ? 0 : ch_flags[p[i]];
+    }
 
-// ADC board의 I2C Device addr. 6개의 ltc2309 device가 있음.
-const unsigned char ADC_I2C_ADDR[] = {
-    0x08, 0x09, 0x0A, 0x0B, 0x18, 0x19
-};
+    return cnt;
+}
 
-// ADC Channel register address.
-const unsigned char ADC_CH_ADDR[] = {
-    0x88, 0xC8, 0x98, 0xD8, 0xA8, 0xE8, 0xB8, 0xF8
-};
+//------------------------------------------------------------------------------
+// Oversampling scan. need[chip/channel]이 설정된 channel을 samples회씩 연속으로 변환하여
+// 통계값을 stat[chip/channel]에 저장함. 같은 channel의 반복 변환도 pipeline으로 처리되므로
+// chip당 address 설정 1회, 변환당 1회의 transaction으로 처리됨.
+// bus error 등 유효하지 않은(ADC_FLAG_INVALID) sample은 통계에서 제외하며
+// stat.samples = 통계에 사용한 sample 수, stat.flags = sample flags (OR)
+// return 0 : success, -1 : memory alloc fail
+//------------------------------------------------------------------------------
+static int scan_oversample (adc_board_t *b, const unsigned char *need, int samples, struct adc_stat *stat)
+{
+    struct scan_item *item;
+    long long sum, sq;
+    int i, j, n, min, max, idx, raw, cnt, flags;
+    double var;
 
-// Header pin info CON1, P1.1 ~ P1.6, P3 port control.
-struct pin_info {
-    const char *name;
-    unsigned char pin_num;
-    unsigned char adc_idx;
-    unsigned char ch_idx;
-};
+    for (i = 0, n = 0; i < SCAN_CH_MAX; i++)
+        n += need[i] ? samples : 0;
 
-const struct pin_info HEADER_CON1[] = {
-    { "CON1.0" ,   0, NOT_USED , 0},    // Header Pin 0
-
-    { "CON1.1" ,   1, CHIP_ADC0, 0},    // Header Pin 1 Info
-    { "CON1.2" ,   2, CHIP_ADC0, 1},    // Header Pin 2 Info
-    { "CON1.3" ,   3, CHIP_ADC1, 0},
-    { "CON1.4" ,   4, CHIP_ADC0, 2},
-    { "CON1.5" ,   5, CHIP_ADC1, 1},
-    { "CON1.6" ,   6, NOT_USED , 0},
-    { "CON1.7" ,   7, CHIP_ADC1, 2},
-    { "CON1.8" ,   8, CHIP_ADC1, 3},
-    { "CON1.9" ,   9, NOT_USED , 0},
-    { "CON1.10",  10, CHIP_ADC1, 4},
-
-    { "CON1.11",  11, CHIP_ADC1, 5},
-    { "CON1.12",  12, CHIP_ADC1, 6},
-    { "CON1.13",  13, CHIP_ADC1, 7},
-    { "CON1.14",  14, NOT_USED , 0},
-    { "CON1.15",  15, CHIP_ADC2, 0},
-    { "CON1.16",  16, CHIP_ADC2, 1},
-    { "CON1.17",  17, CHIP_ADC0, 3},
-    { "CON1.18",  18, CHIP_ADC2, 2},
-    { "CON1.19",  19, CHIP_ADC2, 3},
-    { "CON1.20",  20, NOT_USED , 0},
-
-    { "CON1.21",  21, CHIP_ADC2, 4},
-    { "CON1.22",  22, CHIP_ADC2, 5},
-    { "CON1.23",  23, CHIP_ADC2, 6},
-    { "CON1.24",  24, CHIP_ADC2, 7},
-    { "CON1.25",  25, NOT_USED , 0},
-    { "CON1.26",  26, CHIP_ADC3, 0},
-    { "CON1.27",  27, CHIP_ADC3, 1},
-    { "CON1.28",  28, CHIP_ADC3, 2},
-    { "CON1.29",  29, CHIP_ADC3, 3},
-    { "CON1.30",  30, NOT_USED , 0},
-
-    { "CON1.31",  31, CHIP_ADC3, 4},
-    { "CON1.32",  32, CHIP_ADC3, 5},
-    { "CON1.33",  33, CHIP_ADC3, 6},
-    { "CON1.34",  34, NOT_USED , 0},
-    { "CON1.35",  35, CHIP_ADC3, 7},
-    { "CON1.36",  36, CHIP_ADC4, 0},
-    { "CON1.37",  37, NOT_USED , 0},
-    { "CON1.38",  38, CHIP_ADC0, 4},
-    { "CON1.39",  39, NOT_USED , 0},
-    { "CON1.40",  40, NOT_USED , 0},
-};
+    if ((item = malloc(sizeof(struct scan_item) * (n ? n : 1))) == NULL)
+        return -1;
 
-const struct pin_info HEADER_P3[] = {
-    { "P3.0" ,  0, NOT_USED , 0},   // Header Pin 0
-    { "P3.1" ,  1, NOT_USED , 0},   // Header Pin 1 Info
-    { "P3.2" ,  2, CHIP_ADC5, 0},   // Header Pin 2 Info
-    { "P3.3" ,  3, CHIP_ADC5, 1},
-    { "P3.4" ,  4, NOT_USED , 0},
-    { "P3.5" ,  5, CHIP_ADC5, 2},
-    { "P3.6" ,  6, CHIP_ADC5, 3},
-    { "P3.7" ,  7, NOT_USED , 0},
-    { "P3.8" ,  8, CHIP_ADC5, 4},
-    { "P3.9" ,  9, CHIP_ADC5, 5},
-    { "P3.10", 10, NOT_USED , 0},
-};
+    for (i = 0, n = 0; i < SCAN_CH_MAX; i++) {
+        for (j = 0; need[i] && (j < samples); j++, n++) {
+            item[n].adc_idx = i / ADC_CH_CNT;
+            item[n].ch_idx  = i % ADC_CH_CNT;
+            item[n].idx     = i;
+        }
+    }
+    scan_items (b, item, n, NULL);
 
-const struct pin_info HEADER_P13[] = {
-    { "P13.0", 0, NOT_USED , 0},    // Header Pin 0
-    { "P13.1", 1, NOT_USED , 0},    // Header Pin 1 Info
-    { "P13.2", 2, CHIP_ADC4, 1},    // Header Pin 2 Info
-    { "P13.3", 3, CHIP_ADC0, 5},
-    { "P13.4", 4, CHIP_ADC4, 2},
-    { "P13.5", 5, CHIP_ADC4, 3},
-    { "P13.6", 6, CHIP_ADC4, 4},
-    { "P13.7", 7, CHIP_ADC4, 5},
-};
+    for (i = 0; i < n; i += samples) {
+        sum = sq = 0, min = 0x7FFF, max = -0x8000, cnt = 0, flags = 0;
+        for (j = i; j < i + samples; j++) {
+            flags |= item[j].flags;
+            if (item[j].flags & ADC_FLAG_INVALID)
+                continue;
+            cnt++;
+            // bipolar channel은 int16 raw
+            raw  = (short)item[j].raw;
+            sum += raw;
+            sq  += raw * raw;
+            min  = (raw < min) ? raw : min;
+            max  = (raw > max) ? raw : max;
+        }
+        idx = item[i].idx;
+        memset(&stat[idx], 0, sizeof(struct adc_stat));
+        stat[idx].flags = flags;
+        if (!cnt)
+            continue;
 
-const struct pin_info HEADER_P1_1[] = {
-    { "P1_1.0", 0, NOT_USED , 0},   // Header Pin 0
-    { "P1_1.1", 1, CHIP_ADC0, 7},   // Header Pin 1 Info
-    { "P1_1.2", 2, CHIP_ADC0, 6},   // Header Pin 2 Info
-    { "P1_1.3", 3, CHIP_ADC0, 5},
-    { "P1_1.4", 4, CHIP_ADC0, 4},
-    { "P1_1.5", 5, CHIP_ADC0, 3},
-    { "P1_1.6", 6, CHIP_ADC0, 2},
-    { "P1_1.7", 7, CHIP_ADC0, 1},
-    { "P1_1.8", 8, CHIP_ADC0, 0},
-};
+        var = ((double)sq - (double)sum * sum / cnt) / cnt;
+        stat[idx].samples   = cnt;
+        stat[idx].mean_mv   = (int)(((long long)(sum * b->cal.gain[idx] / cnt)
+                                    + b->cal.offset[idx]) >> 16);
+        stat[idx].min_mv    = cal_mv (&b->cal, idx, min);
+        stat[idx].max_mv    = cal_mv (&b->cal, idx, max);
+        stat[idx].stddev_uv = (var > 0) ? (int)(sqrt(var) * b->cal.gain[idx] * 1000 / 65536) : 0;
+    }
+    free (item);
+    return 0;
+}
 
-const struct pin_info HEADER_P1_2[] = {
-    { "P1_2.0", 0, NOT_USED , 0},   // Header Pin 0
-    { "P1_2.1", 1, CHIP_ADC1, 7},   // Header Pin 1 Info
-    { "P1_2.2", 2, CHIP_ADC1, 6},   // Header Pin 2 Info
-    { "P1_2.3", 3, CHIP_ADC1, 5},
-    { "P1_2.4", 4, CHIP_ADC1, 4},
-    { "P1_2.5", 5, CHIP_ADC1, 3},
-    { "P1_2.6", 6, CHIP_ADC1, 2},
-    { "P1_2.7", 7, CHIP_ADC1, 1},
-    { "P1_2.8", 8, CHIP_ADC1, 0},
-};
+//------------------------------------------------------------------------------
+// 6개의 ADC 중 응답하는 chip을 확인하여 b->present에 저장함. return : 응답한 chip 수
+//
+// adapter가 I2C_FUNC_I2C를 지원하면 모든 chip의 2 byte read를 1회의 ioctl로 확인함.
+// read만 하는 경우 LTC2309는 이전 설정(DIN)을 유지하므로 channel 설정이 바뀌지 않음.
+// 없는 chip이 있으면(NACK) ioctl 전체가 실패하므로 chip별 read로 다시 확인함.
+// SMBus만 지원하는 경우 chip별로 channel 0의 command로 read_word를 보냄.
+//------------------------------------------------------------------------------
+static int check_devices (adc_board_t *b)
+{
+    struct i2c_msg msg [ADC_CHIP_CNT];
+    unsigned char buf [ADC_CHIP_CNT][2];
+    int i, cnt, chips;
 
-const struct pin_info HEADER_P1_3[] = {
-    { "P1_3.0", 0, NOT_USED , 0},   // Header Pin 0
-    { "P1_3.1", 1, CHIP_ADC2, 7},   // Header Pin 1 Info
-    { "P1_3.2", 2, CHIP_ADC2, 6},   // Header Pin 2 Info
-    { "P1_3.3", 3, CHIP_ADC2, 5},
-    { "P1_3.4", 4, CHIP_ADC2, 4},
-    { "P1_3.5", 5, CHIP_ADC2, 3},
-    { "P1_3.6", 6, CHIP_ADC2, 2},
-    { "P1_3.7", 7, CHIP_ADC2, 1},
-    { "P1_3.8", 8, CHIP_ADC2, 0},
-};
+    b->present = 0;
+    chips = __builtin_popcount(b->chips);
+    if (bus_funcs (b) & I2C_FUNC_I2C) {
+        for (i = 0; i < chips; i++) {
+            msg[i].addr  = b->chip_addr[i];
+            msg[i].flags = I2C_M_RD;
+            msg[i].len   = 2;
+            msg[i].buf   = buf[i];
+        }
+        if (!bus_rdwr (b, msg, chips))
+            b->present = b->chips;
+        else
+            for (i = 0; i < chips; i++)
+                b->present |= !bus_rdwr (b, &msg[i], 1) ? (1 << i) : 0;
+    } else {
+        for (i = 0; i < chips; i++) {
+            if (bus_set_addr(b, b->chip_addr[i]) || (bus_read_word(b, CH_CMD(b, i, 0)) < 0))
+                continue;
+            b->present |= 1 << i;
+            chip_set_pend (b, i, CH_CMD(b, i, 0), now_ns());
+        }
+    }
 
-const struct pin_info HEADER_P1_4[] = {
-    { "P1_4.0", 0, NOT_USED , 0},   // Header Pin 0
-    { "P1_4.1", 1, CHIP_ADC3, 7},   // Header Pin 1 Info
-    { "P1_4.2", 2, CHIP_ADC3, 6},   // Header Pin 2 Info
-    { "P1_4.3", 3, CHIP_ADC3, 5},
-    { "P1_4.4", 4, CHIP_ADC3, 4},
-    { "P1_4.5", 5, CHIP_ADC3, 3},
-    { "P1_4.6", 6, CHIP_ADC3, 2},
-    { "P1_4.7", 7, CHIP_ADC3, 1},
-    { "P1_4.8", 8, CHIP_ADC3, 0},
-};
+    for (i = 0, cnt = 0; i < ADC_CHIP_CNT; i++)
+        cnt += CHIP_PRESENT(b, i) ? 1 : 0;
 
-const struct pin_info HEADER_P1_5[] = {
-    { "P1_5.0", 0, NOT_USED , 0},   // Header Pin 0
-    { "P1_5.1", 1, CHIP_ADC4, 7},   // Header Pin 1 Info
-    { "P1_5.2", 2, CHIP_ADC4, 6},   // Header Pin 2 Info
-    { "P1_5.3", 3, CHIP_ADC4, 5},
-    { "P1_5.4", 4, CHIP_ADC4, 4},
-    { "P1_5.5", 5, CHIP_ADC4, 3},
-    { "P1_5.6", 6, CHIP_ADC4, 2},
-    { "P1_5.7", 7, CHIP_ADC4, 1},
-    { "P1_5.8", 8, CHIP_ADC4, 0},
-};
+#if defined (__LIB_I2CADC_DEBUG__)
+    printf ("%s : fd = %d, present = 0x%02X (%d/%d)\n",
+        __func__, b->fd, b->present, cnt, chips);
+#endif
+    return cnt;
+}
 
-const struct pin_info HEADER_P1_6[] = {
-    { "P1_6.0", 0, NOT_USED , 0},   // Header Pin 0
-    { "P1_6.1", 1, CHIP_ADC5, 7},   // Header Pin 1 Info
-    { "P1_6.2", 2, CHIP_ADC5, 6},   // Header Pin 2 Info
-    { "P1_6.3", 3, CHIP_ADC5, 5},
-    { "P1_6.4", 4, CHIP_ADC5, 4},
-    { "P1_6.5", 5, CHIP_ADC5, 3},
-    { "P1_6.6", 6, CHIP_ADC5, 2},
-    { "P1_6.7", 7, CHIP_ADC5, 1},
-    { "P1_6.8", 8, CHIP_ADC5, 0},
-};
+//------------------------------------------------------------------------------
+// ADC board(i2c_dev_node)를 open하고 board context를 생성함. return NULL : fail
+// 일부 chip만 응답하는 board도 사용 가능함. (응답한 chip은 adc_board_present로 확인)
+//------------------------------------------------------------------------------
+adc_board_t *adc_board_open (const char *i2c_dev_node)
+{
+    adc_board_t *b;
+    int fd;
+
+    if ((fd = i2c_open(i2c_dev_node)) < 0)
+        return NULL;
+
+    if ((b = board_alloc (fd)) == NULL) {
+        close (fd);
+        return NULL;
+    }
+    if (check_devices (b))
+        return b;
 
-#define	ARRARY_SIZE(x)	(sizeof(x) / sizeof(x[0]))
+    printf ("Can not found adc board. i2c_dev = %s\n", i2c_dev_node);
+    close (fd);
+    board_free (b);
+
+    return NULL;
+}
 
 //------------------------------------------------------------------------------
+// I2C backend(ops, ctx)로 board context를 생성함. (mock, 다른 adapter 등)
+// adc_board_close()에서 ops->close(ctx)가 호출됨. board의 fd는 -1. return NULL : fail
 //------------------------------------------------------------------------------
-// function prototype
+adc_board_t *adc_board_open_bus (const struct adc_bus_ops *ops, void *ctx)
+{
+    adc_board_t *b;
+
+    if ((ops == NULL) || !ops->set_addr || !ops->read_word || !ops->rdwr ||
+        !ops->read || !ops->write || !ops->funcs)
+        return NULL;
+
+    if ((b = board_alloc (-1)) == NULL)
+        return NULL;
+
+    b->ops     = ops;
+    b->bus_ctx = ctx;
+    if (check_devices (b))
+        return b;
+
+    printf ("Can not found adc board. bus = %s\n", ops->name ? ops->name : "unknown");
+    board_free (b);
+
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+void adc_board_close (adc_board_t *b)
+{
+    if (b == NULL)
+        return;
+
+    if (b->ops->close)
+        b->ops->close (b->bus_ctx);
+    board_free (b);
+}
+
+//------------------------------------------------------------------------------
+// fd API(adc_board_init)로 open한 board(fd)의 context.
+// return NULL : adc_board_init으로 등록되지 않은 fd
+// (adc_board_open으로 생성한 context의 fd는 사용하면 안됨)
+//------------------------------------------------------------------------------
+adc_board_t *adc_board_get (int fd)
+{
+    adc_board_t *b = NULL;
+    int i;
+
+    if (fd <= 0)
+        return NULL;
+
+    pthread_mutex_lock(&BoardsLock);
+    for (i = 0; i < BOARD_MAX; i++) {
+        if (Boards[i] && (Boards[i]->fd == fd)) {
+            b = Boards[i];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&BoardsLock);
+
+    return b;
+}
+
+//------------------------------------------------------------------------------
+int adc_board_fd (adc_board_t *b)
+{
+    return b ? b->fd : -1;
+}
+
+//------------------------------------------------------------------------------
+// probe에서 응답한 chip bitmap (bit = chip index). 없는 chip의 pin은 읽지 않고 0 mV.
+//------------------------------------------------------------------------------
+int adc_board_present (adc_board_t *b)
+{
+    return b ? b->present : -1;
+}
+
+//------------------------------------------------------------------------------
+// 진행중인 conversion 결과의 사용 허용 시간. (age_us = 0 : 항상 새로 conversion)
+//------------------------------------------------------------------------------
+int adc_board_set_conv_age (adc_board_t *b, int age_us)
+{
+    if ((b == NULL) || (age_us < 0))
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    b->conv_age_ns = age_us * 1000ULL;
+    pthread_mutex_unlock(&b->lock);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// pin handle(chip/channel)의 input mode 설정. (ADC_MODE_DIFF | ADC_MODE_BIPOLAR)
+// differential은 channel 쌍(0/1, 2/3 ..)의 두 channel을 모두 사용하며 IN+ = pin 입니다.
+// bipolar는 raw가 int16(sign-extended)이 되며 mV도 음수가 될 수 있음.
+// return 0 : success, -1 : 잘못된 handle 또는 mode
+//------------------------------------------------------------------------------
+int adc_board_set_mode (adc_board_t *b, adc_pin_t pin, int mode)
+{
+    if ((b == NULL) || (pin >= ADC_CHIP_CNT * ADC_CH_CNT))
+        return -1;
+    if (mode & ~(ADC_MODE_DIFF | ADC_MODE_BIPOLAR))
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    b->mode [pin] = mode;
+    b->cmd  [pin] = mode_cmd (pin % ADC_CH_CNT, mode);
+    pthread_mutex_unlock(&b->lock);
+    return 0;
+}
+
 //------------------------------------------------------------------------------
-static  void                toupperstr      (char *p);
+int adc_board_get_mode (adc_board_t *b, adc_pin_t pin)
+{
+    int mode;
 
-static  int                 read_pin        (int fd, struct pin_info *info);
-static  int                 convert_to_mv   (unsigned short adc_value);
-static  struct pin_info     *header_info    (const char *h_name, int pin_no, int *p_cnt);
-static  int                 check_devices   (int fd);
+    if ((b == NULL) || (pin >= ADC_CHIP_CNT * ADC_CH_CNT))
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    mode = b->mode [pin];
+    pthread_mutex_unlock(&b->lock);
+    return mode;
+}
+
+//------------------------------------------------------------------------------
+// chip_mask(bit = chip index)의 chip은 scan이 끝나면 sleep(SLP)으로 들어감.
+// 다음 scan 시작시 깨운 후 refwake_us(tREFWAKE, REFCOMP capacitor에 따라 다름)를
+// 기다리므로 scan 간격이 긴 경우에만 사용. (refwake_us < 0 : 현재 값 유지)
+// sleep 설정을 해제한 chip도 sleep 중이면 다음 scan에서 깨움.
+//------------------------------------------------------------------------------
+int adc_board_set_sleep (adc_board_t *b, int chip_mask, int refwake_us)
+{
+    if ((b == NULL) || (chip_mask & ~b->chips))
+        return -1;
 
-        int adc_board_read  (int fd, const char *name, int *read_value, int *cnt);
-        int adc_board_init  (const char *i2c_dev_node);
+    pthread_mutex_lock(&b->lock);
+    b->sleep_mask = chip_mask;
+    if (refwake_us >= 0)
+        b->refwake_ns = refwake_us * 1000ULL;
+    pthread_mutex_unlock(&b->lock);
+    return 0;
+}
 
 //------------------------------------------------------------------------------
+// pin name(CON1.1) 또는 header name(CON1)을 pin handle로 변환함.
+// 반복해서 읽는 경우 미리 handle로 변환하여 사용하면 문자열 처리가 필요 없음.
+// return : header pin 수 (max보다 큰 경우 max개만 저장), 0 : 없음, -1 : error
 //------------------------------------------------------------------------------
-static void toupperstr (char *p)
+int adc_pin_resolve (const char *name, adc_pin_t *pins, int max)
 {
-    int i, c = strlen(p);
+    const adc_pin_t *p;
+    int pin_no, pin_cnt;
+
+    if ((name == NULL) || (pins == NULL))
+        return -1;
 
-    for (i = 0; i < c; i++, p++)
-        *p = toupper(*p);
+    p = desc_find (name, NULL, &pin_no, &pin_cnt);
+
+    if (pin_cnt)
+        memcpy(pins, p, sizeof(adc_pin_t) * ((pin_cnt < max) ? pin_cnt : (max > 0) ? max : 0));
+
+    return pin_cnt;
 }
 
 //------------------------------------------------------------------------------
-static int read_pin (int fd, struct pin_info *info)
+// pin handle의 mV값을 읽어옴. bus error 등 유효하지 않은 sample은 0 mV
+// return -1 : 잘못된 handle 또는 없는 chip의 pin
+//------------------------------------------------------------------------------
+int adc_board_read_pin (adc_board_t *b, adc_pin_t pin)
 {
-    int read_val = 0, retry = 3;
+    unsigned char flags;
+    int mv;
 
-    if (info->adc_idx == NOT_USED)
+    if (b == NULL)
+        return -1;
+    if (pin == ADC_PIN_NC)
         return 0;
+    if ((pin >= SCAN_CH_MAX) || !CHIP_PRESENT(b, pin / ADC_CH_CNT))
+        return -1;
 
-    while (i2c_set_addr(fd, ADC_I2C_ADDR [info->adc_idx]) && retry --)
-        usleep(100);
-
-    if (retry) {
-        // Dummy read for chip wake up & conversion
-        i2c_read_word(fd, ADC_CH_ADDR [info->ch_idx]);
-        read_val  = i2c_read_word(fd, ADC_CH_ADDR [info->ch_idx]);
-        read_val  = (read_val < 0) ? 0 : read_val;
-        read_val  = (SWAP_WORD (read_val) >> 4) & 0xFFF;
-    }
-    return read_val;
-}
-
-//------------------------------------------------------------------------------
-static int convert_to_mv (unsigned short adc_value)
-{
-    int volt = adc_value * ADC_WEIGHT_uV;
-    return	(volt / 1000);
-}
-
-//------------------------------------------------------------------------------
-static struct pin_info *header_info(const char *h_name, int pin_no, int *p_cnt)
-{
-    const struct pin_info *p;
-
-    if          (!strncmp("CON1", h_name, strlen ("CON1"))) {
-        pin_no  = pin_no < (int)ARRARY_SIZE(HEADER_CON1) ? pin_no : 0;
-        p       = pin_no ? &HEADER_CON1 [pin_no] : &HEADER_CON1[1];
-        *p_cnt  = pin_no ? 1 : ARRARY_SIZE(HEADER_CON1) -1;
-    } else if   (!strncmp("P3"  , h_name, strlen ("P3"))) {
-        pin_no  = pin_no < (int)ARRARY_SIZE(HEADER_P3) ? pin_no : 0;
-        p       = pin_no ? &HEADER_P3 [pin_no] : &HEADER_P3[1];
-        *p_cnt  = pin_no ? 1 : ARRARY_SIZE(HEADER_P3) -1;
-    } else if   (!strncmp("P13" , h_name, strlen ("P13"))) {
-        pin_no  = pin_no < (int)ARRARY_SIZE(HEADER_P13) ? pin_no : 0;
-        p       = pin_no ? &HEADER_P13 [pin_no] : &HEADER_P13[1];
-        *p_cnt  = pin_no ? 1 : ARRARY_SIZE(HEADER_P13) -1;
-    } else if   (!strncmp("P1_1", h_name, strlen ("P1_1"))) {
-        pin_no  = pin_no < (int)ARRARY_SIZE(HEADER_P1_1) ? pin_no : 0;
-        p       = pin_no ? &HEADER_P1_1 [pin_no] : &HEADER_P1_1[1];
-        *p_cnt  = pin_no ? 1 : ARRARY_SIZE(HEADER_P1_1) -1;
-    } else if   (!strncmp("P1_2", h_name, strlen ("P1_2"))) {
-        pin_no  = pin_no < (int)ARRARY_SIZE(HEADER_P1_2) ? pin_no : 0;
-        p       = pin_no ? &HEADER_P1_2 [pin_no] : &HEADER_P1_2[1];
-        *p_cnt  = pin_no ? 1 : ARRARY_SIZE(HEADER_P1_2) -1;
-    } else if   (!strncmp("P1_3", h_name, strlen ("P1_3"))) {
-        pin_no  = pin_no < (int)ARRARY_SIZE(HEADER_P1_3) ? pin_no : 0;
-        p       = pin_no ? &HEADER_P1_3 [pin_no] : &HEADER_P1_3[1];
-        *p_cnt  = pin_no ? 1 : ARRARY_SIZE(HEADER_P1_3) -1;
-    } else if   (!strncmp("P1_4", h_name, strlen ("P1_4"))) {
-        pin_no  = pin_no < (int)ARRARY_SIZE(HEADER_P1_4) ? pin_no : 0;
-        p       = pin_no ? &HEADER_P1_4 [pin_no] : &HEADER_P1_4[1];
-        *p_cnt  = pin_no ? 1 : ARRARY_SIZE(HEADER_P1_4) -1;
-    } else if   (!strncmp("P1_5", h_name, strlen ("P1_5"))) {
-        pin_no  = pin_no < (int)ARRARY_SIZE(HEADER_P1_5) ? pin_no : 0;
-        p       = pin_no ? &HEADER_P1_5 [pin_no] : &HEADER_P1_5[1];
-        *p_cnt  = pin_no ? 1 : ARRARY_SIZE(HEADER_P1_5) -1;
-    } else if   (!strncmp("P1_6", h_name, strlen ("P1_6"))) {
-        pin_no  = pin_no < (int)ARRARY_SIZE(HEADER_P1_6) ? pin_no : 0;
-        p       = pin_no ? &HEADER_P1_6 [pin_no] : &HEADER_P1_6[1];
-        *p_cnt  = pin_no ? 1 : ARRARY_SIZE(HEADER_P1_6) -1;
-    } else {
-        p = &HEADER_CON1[0];
-        *p_cnt	= 0;
+    pthread_mutex_lock(&b->lock);
+    mv = read_pin (b, pin, &flags);
+    mv = (flags & ADC_FLAG_INVALID) ? 0 : cal_mv (&b->cal, pin, mv);
+    pthread_mutex_unlock(&b->lock);
+
+    return mv;
+}
+
+//------------------------------------------------------------------------------
+// 여러 pin handle(서로 다른 header의 pin 포함 가능)을 한번에 읽어서 mV값을 저장함.
+// 모든 pin을 chip별로 모아서 읽으므로 chip당 1회 address 설정, channel당 1회 transaction.
+// return : 읽은 pin 수, -1 : error (잘못된 handle 포함)
+//------------------------------------------------------------------------------
+int adc_board_read_many (adc_board_t *b, const adc_pin_t *pins, int n, int *read_value)
+{
+    return adc_board_read_flags (b, pins, n, read_value, NULL);
+}
+
+//------------------------------------------------------------------------------
+// adc_board_read_many()와 같으며 flags != NULL이면 pin별 ADC_FLAG_xxx를 flags[n]에 저장함.
+// bus error, 격리/없는 chip의 pin은 0 mV이며 flags & ADC_FLAG_INVALID 로 구분함.
+//------------------------------------------------------------------------------
+int adc_board_read_flags (adc_board_t *b, const adc_pin_t *pins, int n, int *read_value,
+                          unsigned char *flags)
+{
+    unsigned char need [SCAN_CH_MAX], ch_flags [SCAN_CH_MAX];
+    unsigned short raw [SCAN_CH_MAX];
+    int i;
+
+    if ((b == NULL) || (pins == NULL) || (read_value == NULL) || (n < 0))
+        return -1;
+
+    memset(need, 0, sizeof(need));
+    for (i = 0; i < n; i++) {
+        if (pins[i] == ADC_PIN_NC)
+            continue;
+        if (pins[i] >= SCAN_CH_MAX)
+            return -1;
+        need[pins[i]] = 1;
+    }
+    pthread_mutex_lock(&b->lock);
+    scan_channels (b, need, raw, ch_flags, NULL);
+    for (i = 0; i < n; i++) {
+        if (pins[i] == ADC_PIN_NC) {
+            read_value[i] = 0;
+            if (flags)
+                flags[i] = 0;
+            continue;
+        }
+        read_value[i] = (ch_flags[pins[i]] & ADC_FLAG_INVALID) ? 0 :
+                        cal_mv (&b->cal, pins[i], raw[pins[i]]);
+        if (flags)
+            flags[i] = ch_flags[pins[i]];
     }
-    return (struct pin_info *)p;
+    pthread_mutex_unlock(&b->lock);
+
+    return n;
+}
+
+//------------------------------------------------------------------------------
+// adc_board_read_many()와 같으며 변환 없이 12 bits raw code를 저장함. (미사용 pin = 0)
+// mV/uV 변환은 adc_board_conv_mv/uv()로 필요한 곳에서 처리.
+//------------------------------------------------------------------------------
+int adc_board_read_raw (adc_board_t *b, const adc_pin_t *pins, int n, unsigned short *raw)
+{
+    return adc_board_read_raw_flags (b, pins, n, raw, NULL);
 }
 
 //------------------------------------------------------------------------------
-// 6개의 ADC가 정상적으로 응답하는지 확인함.
+// adc_board_read_raw()와 같으며 flags != NULL이면 pin별 ADC_FLAG_xxx를 flags[n]에 저장함.
+// bus error, 격리/없는 chip의 pin은 raw = 0 이므로 접지된 pin과 flags & ADC_FLAG_INVALID 로 구분함.
 //------------------------------------------------------------------------------
-static int check_devices (int fd)
+int adc_board_read_raw_flags (adc_board_t *b, const adc_pin_t *pins, int n, unsigned short *raw,
+                              unsigned char *flags)
 {
+    unsigned char need [SCAN_CH_MAX], ch_flags [SCAN_CH_MAX];
+    unsigned short ch_raw [SCAN_CH_MAX];
     int i;
 
-    for (i = 0; i < (int)ARRARY_SIZE(ADC_I2C_ADDR); i++) {
-        i2c_set_addr(fd, ADC_I2C_ADDR[i]);
-        if(i2c_read_word(fd, ADC_I2C_ADDR[i]) < 0) {
-            return 0;
+    if ((b == NULL) || (pins == NULL) || (raw == NULL) || (n < 0))
+        return -1;
+
+    memset(need, 0, sizeof(need));
+    for (i = 0; i < n; i++) {
+        if (pins[i] == ADC_PIN_NC)
+            continue;
+        if (pins[i] >= SCAN_CH_MAX)
+            return -1;
+        need[pins[i]] = 1;
+    }
+    pthread_mutex_lock(&b->lock);
+    scan_channels (b, need, ch_raw, ch_flags, NULL);
+    pthread_mutex_unlock(&b->lock);
+
+    for (i = 0; i < n; i++) {
+        if (pins[i] == ADC_PIN_NC) {
+            raw[i] = 0;
+            if (flags)
+                flags[i] = 0;
+            continue;
         }
+        raw[i] = (ch_flags[pins[i]] & ADC_FLAG_INVALID) ? 0 : ch_raw[pins[i]];
+        if (flags)
+            flags[i] = ch_flags[pins[i]];
     }
-#if defined (__LIB_I2CADC_APP__)
-    printf ("%s pass : fd = %d\n", __func__, fd);
-#endif
-    return 1;
+    return n;
 }
 
 //------------------------------------------------------------------------------
-// Header name 및 Pin 번호를 입력. CON1.1(1개의 데이터 읽어옴) or CON1 (40개의 데이터 읽어옴)
-// read_value에 mv값으로 저장함.
+// 1개 pin을 n회 연속 변환하여 raw code를 raw[n]에 저장함. (변환당 1회 transaction)
+// return : 저장한 수, -1 : error
 //------------------------------------------------------------------------------
-int adc_board_read (int fd, const char *h_name, int *read_value, int *cnt)
+int adc_board_read_burst (adc_board_t *b, adc_pin_t pin, unsigned short *raw, int n)
+{
+    return adc_board_read_burst_flags (b, pin, raw, n, NULL);
+}
+
+//------------------------------------------------------------------------------
+// adc_board_read_burst()와 같으며 flags != NULL이면 sample별 ADC_FLAG_xxx를 flags[n]에 저장함.
+// 유효하지 않은 sample(flags & ADC_FLAG_INVALID)은 raw = 0
+//------------------------------------------------------------------------------
+int adc_board_read_burst_flags (adc_board_t *b, adc_pin_t pin, unsigned short *raw, int n,
+                                unsigned char *flags)
+{
+    struct scan_item *item;
+    int i;
+
+    if ((b == NULL) || (raw == NULL) || (n < 0) || (pin >= SCAN_CH_MAX))
+        return -1;
+
+    if ((item = malloc(sizeof(struct scan_item) * (n ? n : 1))) == NULL)
+        return -1;
+
+    for (i = 0; i < n; i++) {
+        item[i].adc_idx = pin / ADC_CH_CNT;
+        item[i].ch_idx  = pin % ADC_CH_CNT;
+        item[i].idx     = pin;
+    }
+    pthread_mutex_lock(&b->lock);
+    scan_items (b, item, n, NULL);
+    pthread_mutex_unlock(&b->lock);
+
+    for (i = 0; i < n; i++) {
+        raw[i] = (item[i].flags & ADC_FLAG_INVALID) ? 0 : item[i].raw;
+        if (flags)
+            flags[i] = item[i].flags;
+    }
+    free (item);
+    return n;
+}
+
+//------------------------------------------------------------------------------
+// Oversampling read. 각 pin을 samples회 연속 변환하여 평균 mV값을 read_value에 저장함.
+// stat != NULL이면 pin별 평균/최소/최대/표준편차를 stat[n]에 저장함.
+// return : 읽은 pin 수, -1 : error
+//------------------------------------------------------------------------------
+int adc_board_read_avg (adc_board_t *b, const adc_pin_t *pins, int n, int samples,
+                        int *read_value, struct adc_stat *stat)
+{
+    unsigned char need [SCAN_CH_MAX];
+    struct adc_stat ch_stat [SCAN_CH_MAX];
+    int i, ret;
+
+    if ((b == NULL) || (pins == NULL) || (read_value == NULL) || (n < 0))
+        return -1;
+    if ((samples < 1) || (samples > ADC_SAMPLES_MAX))
+        return -1;
+
+    memset(need, 0, sizeof(need));
+    for (i = 0; i < n; i++) {
+        if (pins[i] == ADC_PIN_NC)
+            continue;
+        if (pins[i] >= SCAN_CH_MAX)
+            return -1;
+        need[pins[i]] = 1;
+    }
+    pthread_mutex_lock(&b->lock);
+    ret = scan_oversample (b, need, samples, ch_stat);
+    pthread_mutex_unlock(&b->lock);
+    if (ret)
+        return -1;
+
+    for (i = 0; i < n; i++) {
+        if (pins[i] == ADC_PIN_NC) {
+            read_value[i] = 0;
+            if (stat)
+                memset(&stat[i], 0, sizeof(struct adc_stat));
+            continue;
+        }
+        read_value[i] = ch_stat[pins[i]].mean_mv;
+        if (stat)
+            stat[i] = ch_stat[pins[i]];
+    }
+    return n;
+}
+
+//------------------------------------------------------------------------------
+// Burst-aligned read. 여러 chip의 pin을 가능한 같은 시간에 변환하여 out[n]에 mV값, flags와
+// conversion 시작 시간(ts_ns)을 저장함. skew_ns != NULL이면 유효한 sample의 시간 차이
+// (최대 - 최소)를 저장함.
+//
+// 각 chip의 n번째 pin을 하나의 round로 모아서 모든 chip의 command를 연속으로 보냄.
+// I2C_RDWR는 round가 1회의 ioctl(repeated START)이며 모든 chip이 마지막 STOP에서 동시에
+// 변환을 시작하고, SMBus만 지원하는 adapter는 chip별 transaction 시간만큼 차이가 생김.
+// 같은 chip의 pin은 다른 round에서 변환되므로 1개 chip에 여러 pin이 있으면 skew가 커짐.
+// return : 읽은 pin 수, -1 : error (잘못된 handle 포함)
+//------------------------------------------------------------------------------
+int adc_board_read_aligned (adc_board_t *b, const adc_pin_t *pins, int n,
+                            struct adc_aligned *out, unsigned long long *skew_ns)
 {
-    char *p_name, *pin_str, str[10];
-    int pin_no = 0, pin_cnt = 0, i;
-    struct pin_info *p;
+    unsigned char need [SCAN_CH_MAX], ch_flags [SCAN_CH_MAX];
+    unsigned short raw [SCAN_CH_MAX];
+    unsigned long long ts [SCAN_CH_MAX], t_min = ~0ULL, t_max = 0;
+    int i;
+
+    if ((b == NULL) || (pins == NULL) || (out == NULL) || (n < 0))
+        return -1;
+
+    memset(need, 0, sizeof(need));
+    for (i = 0; i < n; i++) {
+        if (pins[i] == ADC_PIN_NC)
+            continue;
+        if (pins[i] >= SCAN_CH_MAX)
+            return -1;
+        need[pins[i]] = 1;
+    }
+    pthread_mutex_lock(&b->lock);
+    scan_channels (b, need, raw, ch_flags, ts);
+    for (i = 0; i < n; i++) {
+        memset(&out[i], 0, sizeof(struct adc_aligned));
+        if (pins[i] == ADC_PIN_NC)
+            continue;
 
-    if ((h_name == NULL) || !fd)
+        out[i].raw   = raw[pins[i]];
+        out[i].flags = ch_flags[pins[i]];
+        if (out[i].flags & ADC_FLAG_INVALID)
+            continue;
+
+        out[i].mv    = cal_mv (&b->cal, pins[i], raw[pins[i]]);
+        out[i].ts_ns = ts[pins[i]];
+        t_min = (ts[pins[i]] < t_min) ? ts[pins[i]] : t_min;
+        t_max = (ts[pins[i]] > t_max) ? ts[pins[i]] : t_max;
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    if (skew_ns)
+        *skew_ns = (t_max >= t_min) ? t_max - t_min : 0;
+
+    return n;
+}
+
+//------------------------------------------------------------------------------
+// snapshot에서 pin handle의 mV값을 가져옴. return -1 : 잘못된 handle
+//------------------------------------------------------------------------------
+int adc_snapshot_pin (const struct adc_snapshot *snap, adc_pin_t pin)
+{
+    if (pin == ADC_PIN_NC)
+        return 0;
+    if ((snap == NULL) || (pin >= SCAN_CH_MAX))
         return -1;
 
-    memset(str,   0x00, sizeof(str));
-    memcpy(str, h_name, strlen(h_name));
+    return snap->mv[pin / ADC_CH_CNT][pin % ADC_CH_CNT];
+}
 
-    if ((p_name  = strtok(str, ".")) != NULL)
-        toupperstr(p_name);
+//------------------------------------------------------------------------------
+// Header name 및 Pin 번호를 입력. CON1.1(1개의 데이터 읽어옴) or CON1 (40개의 데이터 읽어옴)
+// read_value에 mv값으로 저장함.
+//------------------------------------------------------------------------------
+int adc_board_read_name (adc_board_t *b, const char *h_name, int *read_value, int *cnt)
+{
+    const adc_pin_t *p;
+    const char *hdr;
+    unsigned char flags [ADC_HEADER_PINS];
+    int pin_no, pin_cnt, i;
+    STAT_VAR(t0);
 
-    if ((pin_str = strtok(NULL, " ")) != NULL)
-        pin_no = atoi(pin_str);
+    if ((h_name == NULL) || (b == NULL))
+        return -1;
 
-    p = header_info(p_name, pin_no, &pin_cnt);
+    STAT_BEGIN(t0);
+    p = desc_find (h_name, &hdr, &pin_no, &pin_cnt);
+    STAT_LOOKUP(b, t0);
 
 // DEBUG
-#if defined (__LIB_I2CADC_APP__)
+#if defined (__LIB_I2CADC_DEBUG__)
     printf ("%s : header = %s, pin = %d, pin_cnt = %d\n", h_name, h_name, pin_no, pin_cnt);
 #endif
 
     if (pin_cnt) {
-        for (i = 0; i < pin_cnt; i++, p++) {
-            read_value[i] = convert_to_mv (read_pin (fd, p));
-#if defined (__LIB_I2CADC_APP__)
+        pthread_mutex_lock(&b->lock);
+        if (pin_cnt == 1)
+            read_value[0] = read_pin (b, p[0], &flags[0]);
+        else
+            read_pins (b, p, pin_cnt, read_value, flags);
+
+        // 유효하지 않은 sample(bus error 등)은 adc_board_read_flags와 같이 0 mV
+        for (i = 0; i < pin_cnt; i++)
+            read_value[i] = ((p[i] == ADC_PIN_NC) || (flags[i] & ADC_FLAG_INVALID)) ? 0 :
+                            cal_mv (&b->cal, p[i], read_value[i]);
+        pthread_mutex_unlock(&b->lock);
+
+#if defined (__LIB_I2CADC_DEBUG__)
+        for (i = 0; i < pin_cnt; i++)
             printf ("%s.%d, value = %d mV\n",
-                p_name, (pin_cnt == 1) ? pin_no : i+1, read_value[i]);
+                hdr, (pin_cnt == 1) ? pin_no : i+1, read_value[i]);
 #endif
-        }
         *cnt = pin_cnt;
         return 1;
     }
-#if defined (__LIB_I2CADC_APP__)
+#if defined (__LIB_I2CADC_DEBUG__)
     else
         printf ("can't found %s pin or header\n", h_name);
 #endif
@@ -416,16 +1648,83 @@ int adc_board_read (int fd, const char *h_name, int *read_value, int *cnt)
     return 0;
 }
 
+//------------------------------------------------------------------------------
+// ADC board의 모든 chip/channel(6 x 8)을 1회씩 읽어서 snap에 저장함.
+// header/pin 값은 adc_snapshot_read()로 bus access 없이 snap에서 가져올 수 있음.
+// return 1 : success, 0 : 유효한 sample 없음 (모든 channel의 flags 확인), -1 : error
+//------------------------------------------------------------------------------
+int adc_board_snapshot (adc_board_t *b, struct adc_snapshot *snap)
+{
+    unsigned char need [SCAN_CH_MAX];
+    int i, valid = 0;
+
+    if ((snap == NULL) || (b == NULL))
+        return -1;
+
+    memset(need, 1, sizeof(need));
+    // raw/mv[chip][ch]는 chip/channel 순서의 연속된 배열
+    pthread_mutex_lock(&b->lock);
+    // sampling 시작 시간 (다른 thread의 bus 사용이 끝난 후)
+    snap->ts_ns = now_ns();
+    snap->seq   = 0;
+    scan_channels (b, need, &snap->raw[0][0], &snap->flags[0][0], NULL);
+    cal_convert (&b->cal, &snap->raw[0][0], &snap->mv[0][0], SCAN_CH_MAX);
+    pthread_mutex_unlock(&b->lock);
+
+    // 유효하지 않은 sample은 calibration offset과 관계없이 0 mV
+    for (i = 0; i < SCAN_CH_MAX; i++) {
+        if (snap->flags[i / ADC_CH_CNT][i % ADC_CH_CNT] & ADC_FLAG_INVALID)
+            snap->mv[i / ADC_CH_CNT][i % ADC_CH_CNT] = 0;
+        else
+            valid++;
+    }
+    return valid ? 1 : 0;
+}
+
+//------------------------------------------------------------------------------
+// adc_board_read()와 동일한 형식으로 snapshot에서 header/pin의 mV값을 가져옴.
+//------------------------------------------------------------------------------
+int adc_snapshot_read (const struct adc_snapshot *snap, const char *h_name, int *read_value, int *cnt)
+{
+    const adc_pin_t *p;
+    int pin_no, pin_cnt, i;
+
+    if ((h_name == NULL) || (snap == NULL))
+        return -1;
+
+    p = desc_find (h_name, NULL, &pin_no, &pin_cnt);
+
+    for (i = 0; i < pin_cnt; i++)
+        read_value[i] = (p[i] == ADC_PIN_NC) ? 0 : snap->mv[p[i] / ADC_CH_CNT][p[i] % ADC_CH_CNT];
+
+    *cnt = pin_cnt;
+    return pin_cnt ? 1 : 0;
+}
+
+//------------------------------------------------------------------------------
+// fd API. fd의 board context(registry)를 사용함.
+//------------------------------------------------------------------------------
+int adc_board_read (int fd, const char *h_name, int *read_value, int *cnt)
+{
+    return adc_board_read_name (adc_board_get (fd), h_name, read_value, cnt);
+}
+
 //------------------------------------------------------------------------------
 int adc_board_init (const char *i2c_dev_node)
 {
+    adc_board_t *b;
     int fd;
 
     if ((fd = i2c_open(i2c_dev_node)) < 0)
         return 0;
 
-    if (check_devices (fd))
-        return fd;
+    // 새로 open된 fd는 이전에 같은 번호를 사용했던 fd의 context를 초기화해야 함.
+    if ((b = board_register (fd)) != NULL) {
+        if (check_devices (b))
+            return fd;
+        // probe 실패한 context가 registry에 남지 않도록 해제
+        board_unregister (b);
+    }
 
     printf ("Can not found adc board. i2c_dev = %s\n", i2c_dev_node);
     close (fd);
@@ -434,4 +1733,36 @@ int adc_board_init (const char *i2c_dev_node)
 }
 
 //------------------------------------------------------------------------------
-//------------------------------------------------------------------------------
\ No newline at end of file
+// adc_board_init으로 open한 fd의 context를 registry에서 해제하고 fd를 close 함.
+// adc_board_get(fd)로 시작한 sampler, async, periodic 등은 먼저 종료해야 함.
+// return 0 : success, -1 : 등록되지 않은 fd (close 하지 않음)
+//------------------------------------------------------------------------------
+int adc_board_deinit (int fd)
+{
+    adc_board_t *b = NULL;
+    int i;
+
+    if (fd <= 0)
+        return -1;
+
+    // 검색과 제거를 같은 lock에서 처리 (동시에 호출되어도 1회만 해제)
+    pthread_mutex_lock(&BoardsLock);
+    for (i = 0; i < BOARD_MAX; i++) {
+        if (Boards[i] && (Boards[i]->fd == fd)) {
+            b = Boards[i];
+            Boards[i] = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&BoardsLock);
+
+    if (b == NULL)
+        return -1;
+
+    board_free (b);
+    close (fd);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
@@ -15,11 +15,420 @@
 #ifndef __LIB_I2CADC_H__
 #define __LIB_I2CADC_H__
 
+//------------------------------------------------------------------------------
+// ADC board : LTC2309(8 channel) x 6
+//------------------------------------------------------------------------------
+#define ADC_CHIP_CNT    6
+#define ADC_CH_CNT      8
+
+// Board context. adc_board_open()으로 생성. (fd API는 fd별 context를 내부에서 사용)
+typedef struct adc_board adc_board_t;
+
+// 진행중인 conversion 결과를 dummy read 없이 사용할 수 있는 기본 시간
+#define ADC_CONV_AGE_US 1000
+
+// Calibration gain(Q16, mV/code). 5000 mV / 4096 * 65536
+#define ADC_CAL_GAIN_IDEAL  80000
+
+// Channel input mode (adc_board_set_mode). 기본값 = single-ended, unipolar
+#define ADC_MODE_SE         0x00    // single-ended (channel - COM)
+#define ADC_MODE_DIFF       0x01    // differential (IN+ = channel, IN- = channel ^ 1)
+#define ADC_MODE_BIPOLAR    0x02    // bipolar (raw = sign-extended 12 bits, int16)
+
+// Chip sleep(SLP) 후 reference 안정 시간 (tREFWAKE, REFCOMP = 10uF)
+#define ADC_REFWAKE_US      200000
+
+// Sample flags (adc_snapshot.flags, adc_board_read_flags). 0 = 정상
+#define ADC_FLAG_ERR        0x01    // bus error (retry 후에도 실패), 값 = 0
+#define ADC_FLAG_ISOLATED   0x02    // 격리된 chip (읽지 않음), 값 = 0
+#define ADC_FLAG_ABSENT     0x04    // probe에서 응답하지 않은 chip, 값 = 0
+#define ADC_FLAG_RETRY      0x08    // retry 후 성공 (값은 유효)
+#define ADC_FLAG_INVALID    (ADC_FLAG_ERR | ADC_FLAG_ISOLATED | ADC_FLAG_ABSENT)
+
+// 보드 전체(chip/channel) 1회 sampling 결과
+struct adc_snapshot {
+    unsigned long long  ts_ns;                              // sampling time (CLOCK_MONOTONIC)
+    unsigned int        seq;                                // sampler sequence number (1 ~)
+    unsigned short      raw [ADC_CHIP_CNT][ADC_CH_CNT];     // 12 bits adc value (bipolar : int16)
+    int                 mv  [ADC_CHIP_CNT][ADC_CH_CNT];
+    unsigned char       flags [ADC_CHIP_CNT][ADC_CH_CNT];   // ADC_FLAG_xxx
+};
+
+// Pin handle. adc_pin_resolve()로 pin name을 미리 변환하여 사용 (문자열 처리 없음)
+typedef unsigned short adc_pin_t;
+
+#define ADC_PIN_NC      0xFFFF      // header의 미사용 pin (항상 0 mV)
+
+// header당 최대 pin 수. (header 전체를 읽는 adc_board_read_name 등의 read_value 크기)
+#define ADC_HEADER_PINS 64
+
+// Oversampling 결과 (adc_board_read_avg)
+#define ADC_SAMPLES_MAX 1024
+
+struct adc_stat {
+    int     mean_mv;
+    int     min_mv;
+    int     max_mv;
+    int     stddev_uv;
+    int     samples;        // 통계에 사용한 정상 sample 수 (0 : 값 없음, 모두 0 mV)
+    int     flags;          // 모든 sample의 ADC_FLAG_xxx (OR, ADC_FLAG_INVALID sample은 제외됨)
+};
+
+// Burst-aligned read 결과 (adc_board_read_aligned)
+struct adc_aligned {
+    unsigned long long  ts_ns;      // conversion 시작 시간 (CLOCK_MONOTONIC, 유효하지 않은 sample = 0)
+    int                 mv;
+    unsigned short      raw;        // 12 bits adc value (bipolar : int16)
+    unsigned char       flags;      // ADC_FLAG_xxx
+};
+
+// Background sampler (lib_i2cadc_sampler.c)
+struct adc_sampler;
+
+// Accumulator window 통계 (adc_sampler_accum)
+struct adc_accum {
+    unsigned long long  samples;                // 정상 sample 수 (0 : 통계 없음)
+    unsigned int        invalid;                // 제외된 sample 수 (ADC_FLAG_INVALID)
+    struct adc_stat     stat;                   // mean/min/max/stddev
+    int                 rms_uv;                 // sqrt(mean(mV^2))
+};
+
+// Window monitor event (adc_sampler_watch)
+enum {
+    ADC_WIN_IN = 0,         // min_mv <= value <= max_mv
+    ADC_WIN_LOW,            // value < min_mv
+    ADC_WIN_HIGH,           // value > max_mv
+};
+
+struct adc_event {
+    unsigned long long  ts_ns;      // snapshot sampling time
+    adc_pin_t           pin;
+    unsigned short      raw;
+    int                 state;      // ADC_WIN_xxx (변경된 상태)
+    int                 mv;
+};
+
+// Change detection (lib_i2cadc_delta.c). 마지막 보고값에서 deadband보다 많이 변한 pin
+struct adc_delta;
+
+struct adc_change {
+    adc_pin_t           pin;
+    unsigned short      raw;        // 12 bits adc value (bipolar : int16)
+    int                 mv;
+    unsigned char       flags;      // ADC_FLAG_xxx
+};
+
+// Streaming capture (lib_i2cadc_stream.c)
+struct adc_sample {
+    unsigned long long  ts_ns;      // conversion 시작 시간 (CLOCK_MONOTONIC)
+    unsigned short      raw;        // 12 bits adc value (bipolar : int16)
+};
+
+// 호출자가 제공하는 ring buffer (writer 1, reader 1). size는 2의 승수.
+struct adc_ring {
+    struct adc_sample   *buf;
+    unsigned int        size;
+    unsigned int        head;       // writer (stream thread)
+    unsigned int        tail;       // reader (adc_ring_pop)
+    unsigned int        overrun;    // buffer full로 버려진 sample 수
+};
+
+struct adc_stream;
+
+// Multi board(I2C bus) parallel acquisition (lib_i2cadc_boards.c)
+struct adc_boardset;
+
+// Asynchronous read (lib_i2cadc_async.c). 요청/buffer는 완료될 때까지 호출자가 유지.
+struct adc_req {
+    const adc_pin_t     *pins;
+    int                 n;
+    int                 samples;                // 1 : read_many, > 1 : read_avg
+    int                 *read_value;            // 결과 mV [n]
+    struct adc_stat     *stat;                  // samples > 1, NULL 가능 [n]
+    void                (*done)(struct adc_req *req, void *arg);    // NULL : eventfd 통보
+    void                *arg;
+
+    int                 ret;                    // adc_board_read_many/avg return
+    unsigned long long  ts_ns;                  // 완료 시간 (CLOCK_MONOTONIC)
+    struct adc_req      *next;                  // 내부 사용, adc_async_stop return list
+};
+
+struct adc_async;
+
+// I2C backend (adc_board_open_bus). 기본값은 i2c-dev(lib_i2c), 모든 함수는 ctx를 받음.
+// read_word는 i2c_read_word()와 같은 형식(SMBus word, LSB first)이며 < 0 : error
+// 나머지 함수는 return 0 : success, -1 : error. funcs는 I2C_FUNCS (0 : SMBus만)
+// recover는 SCL clock-out, adapter reset 등으로 bus를 실제로 해제한 경우에만 0을 return 해야 함.
+// (i2c-dev는 user space clock-out 방법이 없으므로 항상 -1, adc_health.bus_recover_fail로 집계)
+struct i2c_msg;
+
+struct adc_bus_ops {
+    const char          *name;
+    int                 (*set_addr)  (void *ctx, unsigned char addr);
+    int                 (*read_word) (void *ctx, unsigned char cmd);
+    int                 (*rdwr)      (void *ctx, struct i2c_msg *msg, int nmsgs);
+    int                 (*read)      (void *ctx, unsigned char *buf, int len);
+    int                 (*write)     (void *ctx, const unsigned char *buf, int len);
+    unsigned long       (*funcs)     (void *ctx);
+    void                (*close)     (void *ctx);               // NULL 가능
+    int                 (*recover)   (void *ctx);               // bus recovery(clock-out), NULL 가능
+};
+
+// Bus error recovery (lib_i2cadc_recover.c, adc_board_set_recovery)
+struct adc_recovery_cfg {
+    int                 retry_max;              // 실패한 chip의 scan당 최대 retry 수
+    int                 backoff_us;             // 첫 retry 간격 (retry마다 2배)
+    int                 budget_us;              // scan당 retry에 사용할 수 있는 최대 시간
+    int                 isolate_fail;           // 연속 실패시 chip 격리 (0 : 격리 안함)
+    int                 probe_us;               // 격리 chip 확인 간격 (실패마다 2배)
+    int                 probe_max_us;
+};
+
+struct adc_health {
+    unsigned char       isolated;               // 격리된 chip (bit = chip index)
+    unsigned long long  retries;
+    unsigned long long  failed [ADC_CHIP_CNT];  // retry 후에도 실패한 chip scan 수
+    unsigned long long  isolations;
+    unsigned long long  restores;               // 격리 후 복귀
+    unsigned long long  bus_recover;            // bus recovery 수 (실패 포함)
+    unsigned long long  bus_recover_fail;
+};
+
+// Mock LTC2309 board (lib_i2cadc_mock.c). H/W 없이 scan/pipeline 동작 확인 및 benchmark용
+struct adc_mock_cfg {
+    unsigned char       present;                // 응답하는 chip (0 : 모두)
+    unsigned long       funcs;                  // I2C_FUNCS (0 : SMBus만)
+    int                 bus_khz;                // bus clock, byte 전송 시간 (0 : 지연 없음)
+    int                 call_us;                // transaction(syscall)당 고정 지연
+    // chip/channel의 입력 전압(mV, COM 기준). NULL : adc_mock_value()
+    int                 (*input_mv)(int chip, int ch, void *arg);
+    // chip transaction의 fault injection (NULL : 없음). return ADC_MOCK_xxx
+    int                 (*fault)(int chip, void *arg);
+    void                *arg;
+};
+
+#define ADC_MOCK_OK         0
+#define ADC_MOCK_NAK        1       // chip NAK (transaction 실패)
+#define ADC_MOCK_STUCK      2       // SDA stuck. recover 전까지 모든 transaction 실패
+
+// Bus statistics (lib_i2cadc_stats.c). __LIB_I2CADC_STATS__로 build한 경우에만 수집함.
+enum {
+    ADC_OP_SET_ADDR = 0,    // slave address 설정 (I2C_SLAVE)
+    ADC_OP_SMBUS,           // SMBus read word
+    ADC_OP_RDWR,            // I2C_RDWR combined transaction
+    ADC_OP_PLAIN,           // plain read/write (stream)
+    ADC_OP_LOOKUP,          // pin name 검색 (adc_board_read_name)
+    ADC_OP_CNT,
+};
+
+// latency histogram : hist[op][n] = 2^n <= ns < 2^(n+1) 인 횟수 (마지막 bin은 이상)
+#define ADC_HIST_BINS   32
+
+struct adc_bus_stats {
+    unsigned long long  trans;                  // chip transaction (command + read) 수
+    unsigned long long  bytes;
+    unsigned long long  addr_switch;            // slave address 변경 수
+    unsigned long long  retry;                  // address 설정 retry
+    unsigned long long  err [ADC_CHIP_CNT];     // chip별 NAK/error
+    unsigned long long  err_bus;                // 여러 chip을 묶은 RDWR error
+    unsigned long long  op  [ADC_OP_CNT];
+    unsigned long long  op_ns [ADC_OP_CNT];     // op별 누적 시간
+    unsigned int        hist  [ADC_OP_CNT][ADC_HIST_BINS];
+};
+
+// Periodic scan (lib_i2cadc_periodic.c)
+struct adc_periodic;
+
+struct adc_periodic_cfg {
+    int                 period_us;
+    const adc_pin_t     *pins;                  // scan pin handle [n]
+    int                 n;
+    int                 priority;               // SCHED_FIFO priority (0 : 일반 scheduling)
+    int                 cpu;                    // CPU affinity (-1 : 설정 안함)
+    // flags[n] : ADC_FLAG_xxx (유효하지 않은 sample은 0 mV)
+    void                (*scan)(unsigned long long ts_ns, const int *mv, const unsigned char *flags,
+                                int n, void *arg);
+    void                *arg;
+};
+
+struct adc_timing {
+    unsigned long long  scans;
+    unsigned long long  missed;                 // scan이 늦어서 건너뛴 주기 수
+    long long           jitter_min_ns;          // scan 시작 - deadline
+    long long           jitter_max_ns;
+    long long           jitter_avg_ns;
+    unsigned long long  scan_max_ns;            // scan(+ callback) 최대 시간
+};
+
+// Rate scheduler (lib_i2cadc_sched.c)
+struct adc_sched;
+
+struct adc_sched_pin {
+    adc_pin_t           pin;
+    int                 rate_hz;                // 목표 sampling rate
+    int                 priority;               // bus 용량이 부족하면 높은 priority부터 rate 유지
+};
+
+struct adc_sched_cfg {
+    const struct adc_sched_pin *pins;           // [n], 같은 pin은 1번만
+    int                 n;
+    int                 tick_us;                // slot 주기 (0 : 가장 높은 rate_hz의 주기)
+    int                 slot_pins;              // slot당 최대 pin 수 (0 : 제한 없음)
+    int                 priority;               // SCHED_FIFO priority (0 : 일반 scheduling)
+    int                 cpu;                    // CPU affinity (-1 : 설정 안함)
+    // tick의 pin[n], mV, flags(ADC_FLAG_xxx, 유효하지 않은 sample은 0 mV)
+    void                (*sample)(unsigned long long ts_ns, const adc_pin_t *pins, const int *mv,
+                                  const unsigned char *flags, int n, void *arg);
+    void                *arg;
+};
+
+struct adc_sched_rate {
+    adc_pin_t           pin;
+    int                 requested_hz;
+    double              planned_hz;             // slot table 배치 rate (0 : 배치 안됨)
+    double              achieved_hz;            // 실제 읽은(정상 sample) 평균 rate
+    unsigned long long  samples;
+};
+
+// Shared memory publication (lib_i2cadc_shm.c)
+#define ADC_SHM_NAME    "/lib_i2cadc"
+
+struct adc_shm;
+
+// Binary capture log (lib_i2cadc_log.c)
+#define ADC_LOG_DELTA   0x01        // 이전 frame과의 차이(int8/int4)로 기록
+
+struct adc_log;
+
 //------------------------------------------------------------------------------
 // function prototype
+// library(libi2cadc.so)는 -fvisibility=hidden으로 build하며 아래 함수만 export 함.
 //------------------------------------------------------------------------------
-extern int adc_board_read   (int fd, const char *name, int *read_value, int *cnt);
-extern int adc_board_init   (const char *i2c_dev_node);
+#pragma GCC visibility push(default)
+
+extern adc_board_t *adc_board_open (const char *i2c_dev_node);
+extern adc_board_t *adc_board_open_bus (const struct adc_bus_ops *ops, void *ctx);
+extern void adc_board_close         (adc_board_t *b);
+extern adc_board_t *adc_board_get  (int fd);
+extern int  adc_board_fd            (adc_board_t *b);
+extern int  adc_board_present       (adc_board_t *b);
+extern int  adc_board_set_conv_age  (adc_board_t *b, int age_us);
+extern int  adc_board_set_mode      (adc_board_t *b, adc_pin_t pin, int mode);
+extern int  adc_board_get_mode      (adc_board_t *b, adc_pin_t pin);
+extern int  adc_board_set_sleep     (adc_board_t *b, int chip_mask, int refwake_us);
+extern int  adc_board_stats         (adc_board_t *b, struct adc_bus_stats *st, int reset);
+extern int  adc_board_set_recovery  (adc_board_t *b, const struct adc_recovery_cfg *cfg);
+extern int  adc_board_health        (adc_board_t *b, struct adc_health *h, int reset);
+extern int  adc_board_recover       (adc_board_t *b);
+
+extern int  adc_board_cal_reset     (adc_board_t *b);
+extern int  adc_board_cal_set       (adc_board_t *b, adc_pin_t pin, int gain, int offset);
+extern int  adc_board_cal_load      (adc_board_t *b, const char *fname);
+extern int  adc_board_conv_mv       (adc_board_t *b, adc_pin_t pin, const unsigned short *raw,
+                                     int *mv, int n);
+extern int  adc_board_conv_uv       (adc_board_t *b, adc_pin_t pin, const unsigned short *raw,
+                                     int *uv, int n);
+
+// board description (chip address, header pin map). 기본값 = ODROID-JIG ADC board
+extern int adc_desc_load        (const char *fname);
+extern const char *adc_desc_header (int idx);
+
+extern int adc_pin_resolve      (const char *name, adc_pin_t *pins, int max);
+extern const char *adc_pin_name (adc_pin_t pin);
+extern int adc_board_read_pin   (adc_board_t *b, adc_pin_t pin);
+extern int adc_board_read_many  (adc_board_t *b, const adc_pin_t *pins, int n, int *read_value);
+extern int adc_board_read_flags (adc_board_t *b, const adc_pin_t *pins, int n, int *read_value,
+                                 unsigned char *flags);
+extern int adc_board_read_avg   (adc_board_t *b, const adc_pin_t *pins, int n, int samples,
+                                 int *read_value, struct adc_stat *stat);
+extern int adc_board_read_aligned (adc_board_t *b, const adc_pin_t *pins, int n,
+                                   struct adc_aligned *out, unsigned long long *skew_ns);
+extern int adc_board_read_raw   (adc_board_t *b, const adc_pin_t *pins, int n, unsigned short *raw);
+extern int adc_board_read_raw_flags (adc_board_t *b, const adc_pin_t *pins, int n, unsigned short *raw,
+                                     unsigned char *flags);
+extern int adc_board_read_burst (adc_board_t *b, adc_pin_t pin, unsigned short *raw, int n);
+extern int adc_board_read_burst_flags (adc_board_t *b, adc_pin_t pin, unsigned short *raw, int n,
+                                       unsigned char *flags);
+extern int adc_board_read_name  (adc_board_t *b, const char *name, int *read_value, int *cnt);
+extern int adc_board_snapshot   (adc_board_t *b, struct adc_snapshot *snap);
+extern int adc_snapshot_pin     (const struct adc_snapshot *snap, adc_pin_t pin);
+extern int adc_snapshot_read    (const struct adc_snapshot *snap, const char *name, int *read_value, int *cnt);
+
+// fd API
+extern int adc_board_read       (int fd, const char *name, int *read_value, int *cnt);
+extern int adc_board_init       (const char *i2c_dev_node);
+extern int adc_board_deinit     (int fd);
+
+extern struct adc_sampler *adc_sampler_start (adc_board_t *b, int period_us);
+extern void adc_sampler_stop        (struct adc_sampler *s);
+extern int  adc_sampler_snapshot    (struct adc_sampler *s, struct adc_snapshot *snap);
+extern int  adc_sampler_read        (struct adc_sampler *s, const char *name, int *read_value, int *cnt);
+extern int  adc_sampler_changes     (struct adc_sampler *s, struct adc_delta *d,
+                                     struct adc_change *out, int max);
+extern int  adc_sampler_watch       (struct adc_sampler *s, adc_pin_t pin, int min_mv, int max_mv);
+extern int  adc_sampler_unwatch     (struct adc_sampler *s, adc_pin_t pin);
+extern int  adc_sampler_event_fd    (struct adc_sampler *s);
+extern int  adc_sampler_events      (struct adc_sampler *s, struct adc_event *ev, int max);
+extern unsigned int adc_sampler_overrun (struct adc_sampler *s);
+extern int  adc_sampler_accum       (struct adc_sampler *s, struct adc_accum *acc,
+                                     unsigned long long *first_ns, unsigned long long *last_ns);
+
+extern struct adc_delta *adc_delta_create (int deadband);
+extern void adc_delta_destroy       (struct adc_delta *d);
+extern int  adc_delta_set_deadband  (struct adc_delta *d, adc_pin_t pin, int deadband);
+extern void adc_delta_reset         (struct adc_delta *d);
+extern int  adc_delta_update        (struct adc_delta *d, const struct adc_snapshot *snap,
+                                     struct adc_change *out, int max);
+
+extern int  adc_ring_init           (struct adc_ring *r, struct adc_sample *buf, unsigned int size);
+extern int  adc_ring_pop            (struct adc_ring *r, struct adc_sample *out, int max);
+extern struct adc_stream *adc_stream_start (adc_board_t *b, adc_pin_t pin, struct adc_ring *r);
+extern int  adc_stream_stop         (struct adc_stream *st);
+
+extern struct adc_boardset *adc_boardset_open (const char **i2c_dev_node, int cnt);
+extern void adc_boardset_close      (struct adc_boardset *bs);
+extern adc_board_t *adc_boardset_board (struct adc_boardset *bs, int idx);
+extern int  adc_boardset_snapshot   (struct adc_boardset *bs, struct adc_snapshot *snap);
+
+extern struct adc_async *adc_async_start (adc_board_t *b);
+extern struct adc_req *adc_async_stop (struct adc_async *a);
+extern int  adc_async_fd            (struct adc_async *a);
+extern int  adc_async_submit        (struct adc_async *a, struct adc_req *req);
+extern int  adc_async_complete      (struct adc_async *a, struct adc_req **reqs, int max);
+
+extern adc_board_t *adc_board_open_mock (const struct adc_mock_cfg *cfg);
+extern int  adc_mock_value          (int chip, int ch);
+extern unsigned long long adc_mock_calls (adc_board_t *b);
+
+extern struct adc_periodic *adc_periodic_start (adc_board_t *b, const struct adc_periodic_cfg *cfg);
+extern void adc_periodic_stop       (struct adc_periodic *p);
+extern int  adc_periodic_timing     (struct adc_periodic *p, struct adc_timing *t, int reset);
+
+extern struct adc_sched *adc_sched_start (adc_board_t *b, const struct adc_sched_cfg *cfg);
+extern void adc_sched_stop          (struct adc_sched *s);
+extern int  adc_sched_rates         (struct adc_sched *s, struct adc_sched_rate *r, int max, int reset);
+extern int  adc_sched_timing        (struct adc_sched *s, struct adc_timing *t, int reset);
+
+extern struct adc_shm *adc_shm_create (const char *name, int period_us);
+extern int  adc_shm_publish         (struct adc_shm *shm, const struct adc_snapshot *snap);
+extern struct adc_shm *adc_shm_open (const char *name);
+extern void adc_shm_close           (struct adc_shm *shm);
+extern int  adc_shm_snapshot        (struct adc_shm *shm, struct adc_snapshot *snap);
+extern int  adc_shm_read_pins       (struct adc_shm *shm, const adc_pin_t *pins, int n,
+                                     int *read_value, unsigned long long *ts_ns);
+extern int  adc_shm_read            (struct adc_shm *shm, const char *name, int *read_value, int *cnt);
+
+extern struct adc_log *adc_log_create (adc_board_t *b, const char *fname, int flags);
+extern int  adc_log_append          (struct adc_log *l, const struct adc_snapshot *snap);
+extern struct adc_log *adc_log_open (const char *fname);
+extern int  adc_log_close           (struct adc_log *l);
+extern int  adc_log_range           (struct adc_log *l, unsigned long long *first_ns,
+                                     unsigned long long *last_ns);
+extern int  adc_log_seek            (struct adc_log *l, unsigned long long ts_ns);
+extern int  adc_log_next            (struct adc_log *l, struct adc_snapshot *snap);
+extern const char *adc_log_pin_name (struct adc_log *l, adc_pin_t pin);
+
+#pragma GCC visibility pop
 
 //------------------------------------------------------------------------------
 #endif  // __LIB_I2CADC_H__
@@ -0,0 +1,279 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_async.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) asynchronous read for ODROID-JIG.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "lib_i2cadc.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Asynchronous read. board별 I/O thread가 요청(struct adc_req)을 순서대로 처리함.
+//
+// 호출자는 adc_async_submit()으로 요청을 전달한 후 바로 return 하며, 완료시
+//  - req->done != NULL : I/O thread에서 done(req, arg) 호출
+//  - req->done == NULL : 완료 list에 추가 후 eventfd(adc_async_fd) 신호.
+//                        epoll 등으로 fd를 기다린 후 adc_async_complete()로 가져옴.
+//
+// 요청과 pins/read_value/stat buffer는 호출자 소유이며 완료될 때까지 유지되어야 함.
+// 여러 board의 async context를 만들면 1개의 control thread에서 모든 bus를 동시에 사용할 수 있음.
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+struct adc_async {
+    adc_board_t         *board;
+    pthread_t           thread;
+    int                 efd;
+    int                 run;
+
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    // 요청 queue, 완료 list (FIFO)
+    struct adc_req      *req_head, *req_tail;
+    struct adc_req      *done_head, *done_tail;
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  unsigned long long  now_ns      (void);
+static  void    req_complete            (struct adc_async *a, struct adc_req *req);
+static  void    *async_thread           (void *arg);
+
+        struct adc_async *adc_async_start (adc_board_t *b);
+        struct adc_req *adc_async_stop  (struct adc_async *a);
+        int     adc_async_fd            (struct adc_async *a);
+        int     adc_async_submit        (struct adc_async *a, struct adc_req *req);
+        int     adc_async_complete      (struct adc_async *a, struct adc_req **reqs, int max);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static unsigned long long now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+static void req_complete (struct adc_async *a, struct adc_req *req)
+{
+    uint64_t one = 1;
+
+    req->ts_ns = now_ns();
+    if (req->done) {
+        req->done (req, req->arg);
+        return;
+    }
+
+    pthread_mutex_lock(&a->lock);
+    req->next = NULL;
+    if (a->done_tail)
+        a->done_tail->next = req;
+    else
+        a->done_head = req;
+    a->done_tail = req;
+    pthread_mutex_unlock(&a->lock);
+
+    if (write(a->efd, &one, sizeof(one)) != sizeof(one))
+        fprintf(stderr, "%s : eventfd write error\n", __func__);
+}
+
+//------------------------------------------------------------------------------
+static void *async_thread (void *arg)
+{
+    struct adc_async *a = (struct adc_async *)arg;
+    struct adc_req *req;
+
+    while (1) {
+        pthread_mutex_lock(&a->lock);
+        while (a->run && (a->req_head == NULL))
+            pthread_cond_wait(&a->cond, &a->lock);
+
+        if (!a->run) {
+            pthread_mutex_unlock(&a->lock);
+            break;
+        }
+        req = a->req_head;
+        if ((a->req_head = req->next) == NULL)
+            a->req_tail = NULL;
+        pthread_mutex_unlock(&a->lock);
+
+        if (req->samples > 1)
+            req->ret = adc_board_read_avg (a->board, req->pins, req->n, req->samples,
+                                           req->read_value, req->stat);
+        else
+            req->ret = adc_board_read_many (a->board, req->pins, req->n, req->read_value);
+
+        req_complete (a, req);
+    }
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+// board의 I/O thread를 시작함.
+//------------------------------------------------------------------------------
+struct adc_async *adc_async_start (adc_board_t *b)
+{
+    struct adc_async *a;
+
+    if (b == NULL)
+        return NULL;
+
+    if ((a = calloc(1, sizeof(struct adc_async))) == NULL)
+        return NULL;
+
+    if ((a->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        free (a);
+        return NULL;
+    }
+    a->board = b;
+    a->run   = 1;
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init (&a->cond, NULL);
+
+    if (pthread_create(&a->thread, NULL, async_thread, a)) {
+        pthread_cond_destroy (&a->cond);
+        pthread_mutex_destroy(&a->lock);
+        close (a->efd);
+        free (a);
+        return NULL;
+    }
+    return a;
+}
+
+//------------------------------------------------------------------------------
+// I/O thread 종료. 처리되지 않은 요청은 ret = -1로 완료됨.
+//  - done != NULL : done(req, arg) 호출
+//  - done == NULL : 완료 list에 추가
+// eventfd와 context는 해제되므로 adc_async_complete()로 가져오지 않은 요청(완료 list)을
+// req->next로 연결하여 완료 순서대로 return 함. (NULL : 남은 요청 없음)
+// return 후 모든 요청 buffer는 재사용 가능.
+//------------------------------------------------------------------------------
+struct adc_req *adc_async_stop (struct adc_async *a)
+{
+    struct adc_req *req, *left;
+
+    if (a == NULL)
+        return NULL;
+
+    pthread_mutex_lock(&a->lock);
+    a->run = 0;
+    pthread_cond_signal(&a->cond);
+    pthread_mutex_unlock(&a->lock);
+    pthread_join(a->thread, NULL);
+
+    while ((req = a->req_head) != NULL) {
+        a->req_head = req->next;
+        req->ret    = -1;
+        req->ts_ns  = now_ns();
+        if (req->done) {
+            req->done (req, req->arg);
+            continue;
+        }
+        req->next = NULL;
+        if (a->done_tail)
+            a->done_tail->next = req;
+        else
+            a->done_head = req;
+        a->done_tail = req;
+    }
+    left = a->done_head;
+
+    pthread_cond_destroy (&a->cond);
+    pthread_mutex_destroy(&a->lock);
+    close (a->efd);
+    free (a);
+    return left;
+}
+
+//------------------------------------------------------------------------------
+// 완료 알림용 eventfd. (EPOLLIN : 완료 list에 요청이 있음)
+//------------------------------------------------------------------------------
+int adc_async_fd (struct adc_async *a)
+{
+    return a ? a->efd : -1;
+}
+
+//------------------------------------------------------------------------------
+// 요청 추가. return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+int adc_async_submit (struct adc_async *a, struct adc_req *req)
+{
+    if ((a == NULL) || (req == NULL) || (req->pins == NULL) || (req->read_value == NULL))
+        return -1;
+    if ((req->n < 0) || (req->samples > ADC_SAMPLES_MAX))
+        return -1;
+
+    req->ret  = 0;
+    req->next = NULL;
+
+    pthread_mutex_lock(&a->lock);
+    if (a->req_tail)
+        a->req_tail->next = req;
+    else
+        a->req_head = req;
+    a->req_tail = req;
+    pthread_cond_signal(&a->cond);
+    pthread_mutex_unlock(&a->lock);
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// 완료된 요청(done == NULL)을 최대 max개 가져옴. (non-blocking)
+// return : 가져온 요청 수
+//------------------------------------------------------------------------------
+int adc_async_complete (struct adc_async *a, struct adc_req **reqs, int max)
+{
+    uint64_t cnt;
+    int n, more;
+
+    if ((a == NULL) || (reqs == NULL))
+        return -1;
+
+    // eventfd counter 초기화 후 list를 확인 (초기화 이후의 완료는 다시 신호됨)
+    if (read(a->efd, &cnt, sizeof(cnt)) < 0)
+        cnt = 0;
+
+    pthread_mutex_lock(&a->lock);
+    for (n = 0; (n < max) && (a->done_head != NULL); n++) {
+        reqs[n] = a->done_head;
+        if ((a->done_head = reqs[n]->next) == NULL)
+            a->done_tail = NULL;
+    }
+    more = (a->done_head != NULL);
+    pthread_mutex_unlock(&a->lock);
+
+    // 남은 요청이 있으면 다시 신호
+    if (more) {
+        cnt = 1;
+        if (write(a->efd, &cnt, sizeof(cnt)) != sizeof(cnt))
+            fprintf(stderr, "%s : eventfd write error\n", __func__);
+    }
+    return n;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
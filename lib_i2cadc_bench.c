@@ -0,0 +1,245 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_bench.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) library benchmark with the mock I2C backend.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <linux/i2c.h>
+
+#include "lib_i2cadc.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+#if defined (__LIB_I2CADC_BENCH__)
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Benchmark. mock backend(lib_i2cadc_mock.c)의 adapter 종류별로 read API의
+// scan/s와 scan당 backend 호출(syscall) 수를 측정하고 결과 값을 확인함.
+//
+//  make bench && ./lib_i2cadc_bench -n 2000 -k 400 -c 20
+//
+// 결과 값이 mock 입력과 다르면 exit code 1 (CI regression test)
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+#define	ARRARY_SIZE(x)	(sizeof(x) / sizeof(x[0]))
+#define BENCH_OP_CNT    5
+
+static int OPT_LOOPS    = 1000;
+static int OPT_BUS_KHZ  = 0;
+static int OPT_CALL_US  = 0;
+
+static const struct {
+    const char      *name;
+    unsigned long   funcs;
+} BENCH_BUS[] = {
+    { "smbus",      0 },
+    { "i2c",        I2C_FUNC_I2C },
+    { "i2c+stop",   I2C_FUNC_I2C | I2C_FUNC_PROTOCOL_MANGLING },
+};
+
+static const char *BENCH_OP[BENCH_OP_CNT] = {
+    "snapshot", "read_many", "read_pin", "read_avg16", "read_name",
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  void    print_usage             (const char *prog);
+static  void    parse_opts              (int argc, char *argv[]);
+static  unsigned long long now_ns       (void);
+static  int     check_mv                (adc_pin_t pin, int mv);
+static  int     bench_op                (adc_board_t *b, int op, const adc_pin_t *pins, int n);
+static  int     bench_bus               (unsigned long funcs, const char *name);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static void print_usage (const char *prog)
+{
+    puts("");
+    printf("Usage: %s [-n:loops] [-k:bus khz] [-c:call us]\n", prog);
+    puts("\n"
+         "  -n --loops          API call count per test (default 1000)\n"
+         "  -k --khz            Simulated bus clock (0 = no delay)\n"
+         "  -c --call           Simulated transaction(syscall) overhead in us\n"
+         "\n"
+         "  e.g) ./lib_i2cadc_bench -n 2000 -k 400 -c 20\n"
+         "\n"
+    );
+    exit(1);
+}
+
+//------------------------------------------------------------------------------
+static void parse_opts (int argc, char *argv[])
+{
+    while (1) {
+        static const struct option lopts[] = {
+            { "loops",  1, 0, 'n' },
+            { "khz",    1, 0, 'k' },
+            { "call",   1, 0, 'c' },
+            { NULL, 0, 0, 0 },
+        };
+        int c;
+
+        c = getopt_long(argc, argv, "n:k:c:h", lopts, NULL);
+
+        if (c == -1)
+            break;
+
+        switch (c) {
+        case 'n':
+            OPT_LOOPS = atoi(optarg);
+            break;
+        case 'k':
+            OPT_BUS_KHZ = atoi(optarg);
+            break;
+        case 'c':
+            OPT_CALL_US = atoi(optarg);
+            break;
+        case 'h':
+        default:
+            print_usage(argv[0]);
+            break;
+        }
+    }
+    if (OPT_LOOPS <= 0)
+        print_usage(argv[0]);
+}
+
+//------------------------------------------------------------------------------
+static unsigned long long now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+// mock 입력 전압과 비교 (양자화 오차 : 1 LSB = 1.22 mV). return 1 : 오류
+//------------------------------------------------------------------------------
+static int check_mv (adc_pin_t pin, int mv)
+{
+    int ref;
+
+    if (pin == ADC_PIN_NC)
+        return mv != 0;
+
+    ref = adc_mock_value (pin / ADC_CH_CNT, pin % ADC_CH_CNT);
+    return (mv < ref - 2) || (mv > ref + 2);
+}
+
+//------------------------------------------------------------------------------
+// op 1회 실행. return : 잘못된 값의 수
+//------------------------------------------------------------------------------
+static int bench_op (adc_board_t *b, int op, const adc_pin_t *pins, int n)
+{
+    struct adc_snapshot snap;
+    int mv [64], i, cnt, bad = 0;
+
+    switch (op) {
+    case 0:
+        adc_board_snapshot (b, &snap);
+        for (i = 0; i < ADC_CHIP_CNT * ADC_CH_CNT; i++)
+            bad += check_mv (i, snap.mv[i / ADC_CH_CNT][i % ADC_CH_CNT]);
+        break;
+    case 1:
+        adc_board_read_many (b, pins, n, mv);
+        for (i = 0; i < n; i++)
+            bad += check_mv (pins[i], mv[i]);
+        break;
+    case 2:
+        bad += check_mv (pins[0], adc_board_read_pin (b, pins[0]));
+        break;
+    case 3:
+        adc_board_read_avg (b, pins, n, 16, mv, NULL);
+        for (i = 0; i < n; i++)
+            bad += check_mv (pins[i], mv[i]);
+        break;
+    case 4:
+        adc_board_read_name (b, "CON1", mv, &cnt);
+        for (i = 0; i < cnt; i++)
+            bad += check_mv (pins[i], mv[i]);
+        break;
+    }
+    return bad;
+}
+
+//------------------------------------------------------------------------------
+// adapter(funcs) 1종류의 모든 op 측정. return : 잘못된 값의 수
+//------------------------------------------------------------------------------
+static int bench_bus (unsigned long funcs, const char *name)
+{
+    struct adc_mock_cfg cfg;
+    unsigned long long t0, ns, calls;
+    adc_pin_t pins [64];
+    adc_board_t *b;
+    int op, i, n, bad = 0;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.funcs   = funcs;
+    cfg.bus_khz = OPT_BUS_KHZ;
+    cfg.call_us = OPT_CALL_US;
+
+    if ((b = adc_board_open_mock (&cfg)) == NULL)
+        return 1;
+
+    n = adc_pin_resolve ("CON1", pins, 64);
+    n = (n > 64) ? 64 : n;
+
+    for (op = 0; op < BENCH_OP_CNT; op++) {
+        calls = adc_mock_calls (b);
+        t0    = now_ns();
+        for (i = 0; i < OPT_LOOPS; i++)
+            bad += bench_op (b, op, pins, n);
+        ns    = now_ns() - t0;
+        calls = adc_mock_calls (b) - calls;
+
+        printf ("%10s %12s %12.1f scans/s %8.2f calls/scan %10.2f us/scan\n",
+            name, BENCH_OP[op], OPT_LOOPS * 1e9 / (ns ? ns : 1),
+            (double)calls / OPT_LOOPS, ns / 1000.0 / OPT_LOOPS);
+    }
+    adc_board_close (b);
+    return bad;
+}
+
+//------------------------------------------------------------------------------------------------------------
+//------------------------------------------------------------------------------------------------------------
+int main (int argc, char *argv[])
+{
+    int i, bad = 0;
+
+    parse_opts(argc, argv);
+
+    printf ("loops = %d, bus = %d kHz, call = %d us (read_many/avg/name : CON1, read_pin : CON1.1)\n",
+        OPT_LOOPS, OPT_BUS_KHZ, OPT_CALL_US);
+
+    for (i = 0; i < (int)ARRARY_SIZE(BENCH_BUS); i++)
+        bad += bench_bus (BENCH_BUS[i].funcs, BENCH_BUS[i].name);
+
+    if (bad)
+        printf ("FAIL : %d wrong values\n", bad);
+
+    return bad ? 1 : 0;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+#endif  // #if defined (__LIB_I2CADC_BENCH__)
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
@@ -0,0 +1,199 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_boards.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief Multi ADC board(LTC2309) parallel acquisition for ODROID-JIG.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "lib_i2cadc.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Board set. 서로 다른 I2C adapter(/dev/i2c-N)에 연결된 여러 ADC board를 관리함.
+//
+// board마다 전용 worker thread가 있으며 adc_boardset_snapshot() 호출시 모든 worker가
+// 동시에 자신의 board를 sampling함. 각 bus는 독립적으로 동작하므로 전체 소요 시간은
+// 가장 느린 bus의 시간과 같음. (board 수의 합이 아님)
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+struct board_worker {
+    struct adc_boardset *bs;
+    adc_board_t         *board;
+    pthread_t           thread;
+    int                 ret;
+};
+
+struct adc_boardset {
+    int                 cnt;
+    struct board_worker *w;
+
+    // worker control (gen 증가 = 새로운 요청)
+    pthread_mutex_t     lock;
+    pthread_cond_t      start;
+    pthread_cond_t      done;
+    unsigned int        gen;
+    int                 pending;
+    int                 run;
+    struct adc_snapshot *snap;
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  void    *board_thread           (void *arg);
+
+        struct adc_boardset *adc_boardset_open (const char **i2c_dev_node, int cnt);
+        void    adc_boardset_close      (struct adc_boardset *bs);
+        adc_board_t *adc_boardset_board (struct adc_boardset *bs, int idx);
+        int     adc_boardset_snapshot   (struct adc_boardset *bs, struct adc_snapshot *snap);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static void *board_thread (void *arg)
+{
+    struct board_worker *w = (struct board_worker *)arg;
+    struct adc_boardset *bs = w->bs;
+    unsigned int gen = 0;
+    int idx = w - bs->w;
+
+    pthread_mutex_lock(&bs->lock);
+    while (1) {
+        while (bs->run && (gen == bs->gen))
+            pthread_cond_wait(&bs->start, &bs->lock);
+        if (!bs->run)
+            break;
+
+        gen = bs->gen;
+        pthread_mutex_unlock(&bs->lock);
+
+        w->ret = adc_board_snapshot (w->board, &bs->snap[idx]);
+
+        pthread_mutex_lock(&bs->lock);
+        if (!--bs->pending)
+            pthread_cond_signal(&bs->done);
+    }
+    pthread_mutex_unlock(&bs->lock);
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+// i2c_dev_node[cnt]의 ADC board를 open하고 board별 worker thread를 시작함.
+// 하나라도 open에 실패하면 NULL.
+//------------------------------------------------------------------------------
+struct adc_boardset *adc_boardset_open (const char **i2c_dev_node, int cnt)
+{
+    struct adc_boardset *bs;
+    int i;
+
+    if ((i2c_dev_node == NULL) || (cnt <= 0))
+        return NULL;
+
+    if ((bs = calloc(1, sizeof(struct adc_boardset))) == NULL)
+        return NULL;
+
+    if ((bs->w = calloc(cnt, sizeof(struct board_worker))) == NULL) {
+        free (bs);
+        return NULL;
+    }
+    pthread_mutex_init(&bs->lock, NULL);
+    pthread_cond_init (&bs->start, NULL);
+    pthread_cond_init (&bs->done,  NULL);
+    bs->run = 1;
+
+    for (i = 0; i < cnt; i++) {
+        bs->w[i].bs = bs;
+        if ((bs->w[i].board = adc_board_open (i2c_dev_node[i])) == NULL)
+            break;
+        if (pthread_create(&bs->w[i].thread, NULL, board_thread, &bs->w[i])) {
+            adc_board_close (bs->w[i].board);
+            break;
+        }
+        bs->cnt++;
+    }
+
+    if (bs->cnt != cnt) {
+        adc_boardset_close (bs);
+        return NULL;
+    }
+    return bs;
+}
+
+//------------------------------------------------------------------------------
+void adc_boardset_close (struct adc_boardset *bs)
+{
+    int i;
+
+    if (bs == NULL)
+        return;
+
+    pthread_mutex_lock(&bs->lock);
+    bs->run = 0;
+    pthread_cond_broadcast(&bs->start);
+    pthread_mutex_unlock(&bs->lock);
+
+    for (i = 0; i < bs->cnt; i++) {
+        pthread_join(bs->w[i].thread, NULL);
+        adc_board_close (bs->w[i].board);
+    }
+    pthread_cond_destroy (&bs->done);
+    pthread_cond_destroy (&bs->start);
+    pthread_mutex_destroy(&bs->lock);
+    free (bs->w);
+    free (bs);
+}
+
+//------------------------------------------------------------------------------
+adc_board_t *adc_boardset_board (struct adc_boardset *bs, int idx)
+{
+    if ((bs == NULL) || (idx < 0) || (idx >= bs->cnt))
+        return NULL;
+
+    return bs->w[idx].board;
+}
+
+//------------------------------------------------------------------------------
+// 모든 board를 동시에 sampling 하여 snap[board 수]에 저장함.
+// 여러 thread에서 동시에 호출하면 안됨. return : 정상적으로 읽은 board 수
+//------------------------------------------------------------------------------
+int adc_boardset_snapshot (struct adc_boardset *bs, struct adc_snapshot *snap)
+{
+    int i, ok;
+
+    if ((bs == NULL) || (snap == NULL))
+        return -1;
+
+    pthread_mutex_lock(&bs->lock);
+    bs->snap    = snap;
+    bs->pending = bs->cnt;
+    bs->gen++;
+    pthread_cond_broadcast(&bs->start);
+
+    while (bs->pending)
+        pthread_cond_wait(&bs->done, &bs->lock);
+    pthread_mutex_unlock(&bs->lock);
+
+    for (i = 0, ok = 0; i < bs->cnt; i++)
+        ok += (bs->w[i].ret > 0) ? 1 : 0;
+
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
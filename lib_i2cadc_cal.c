@@ -0,0 +1,326 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_cal.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) calibration (Q16 fixed point) for ODROID-JIG.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#if defined (__ARM_NEON)
+#include <arm_neon.h>
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "lib_i2cadc.h"
+#include "lib_i2cadc_priv.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Calibration. chip/channel별 gain, offset (Q16 fixed point, mV 단위)
+//
+//  mV = (raw * gain + offset) >> 16
+//
+//  ideal gain = 5000 mV / 4096 * 65536 = 80000 (ADC_CAL_GAIN_IDEAL), offset = 0
+//  |raw| <= 4095 이므로 gain < 524288(8 mV/code) 이고 |offset| + 4095 * gain <= INT32_MAX 이면
+//  raw * gain + offset은 32 bits 범위를 넘지 않음. (cal_valid, 설정/load시 확인)
+//  raw는 int16으로 계산함. (bipolar channel은 sign-extended, unipolar는 0 ~ 4095)
+//  uV 변환은 gain/offset x 1000을 사용하며 64 bits로 계산함.
+//
+// Calibration file (text)
+//  # comment
+//  <chip> <channel> <gain> <offset>
+//
+// Calibration file (binary, host byte order)
+//  "ADCC" + struct adc_cal (gain[48], offset[48] : int32)
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+#define CAL_MAGIC       "ADCC"
+#define CAL_GAIN_MAX    524288
+#define CAL_RAW_MAX     4095
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  int     cal_load_text           (struct adc_cal *cal, FILE *fp);
+static  int     cal_load_bin            (struct adc_cal *cal, FILE *fp);
+        int     cal_valid               (int gain, int offset);
+        void    cal_reset               (struct adc_cal *cal);
+        int     cal_mv                  (const struct adc_cal *cal, int idx, unsigned short raw);
+        void    cal_convert             (const struct adc_cal *cal, const unsigned short *raw,
+                                         int *mv, int cnt);
+static  void    cal_convert_pin         (int gain, long long offset, const unsigned short *raw,
+                                         int *out, int n);
+
+        int     adc_board_cal_reset     (adc_board_t *b);
+        int     adc_board_cal_set       (adc_board_t *b, adc_pin_t pin, int gain, int offset);
+        int     adc_board_cal_load      (adc_board_t *b, const char *fname);
+        int     adc_board_conv_mv       (adc_board_t *b, adc_pin_t pin, const unsigned short *raw,
+                                         int *mv, int n);
+        int     adc_board_conv_uv       (adc_board_t *b, adc_pin_t pin, const unsigned short *raw,
+                                         int *uv, int n);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static int cal_load_text (struct adc_cal *cal, FILE *fp)
+{
+    char line [128];
+    int chip, ch, gain, offset, line_no = 0;
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        line_no++;
+        if ((line[0] == '#') || (line[0] == '\n') || (line[0] == '\r'))
+            continue;
+
+        if ((sscanf(line, "%d %d %d %d", &chip, &ch, &gain, &offset) != 4) ||
+            (chip < 0) || (chip >= ADC_CHIP_CNT) || (ch < 0) || (ch >= ADC_CH_CNT) ||
+            !cal_valid (gain, offset)) {
+            fprintf(stderr, "%s : line %d format error\n", __func__, line_no);
+            return -1;
+        }
+        cal->gain   [chip * ADC_CH_CNT + ch] = gain;
+        cal->offset [chip * ADC_CH_CNT + ch] = offset;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static int cal_load_bin (struct adc_cal *cal, FILE *fp)
+{
+    struct adc_cal tmp;
+    int i;
+
+    if (fread(&tmp, sizeof(tmp), 1, fp) != 1)
+        return -1;
+
+    for (i = 0; i < ADC_CHIP_CNT * ADC_CH_CNT; i++)
+        if (!cal_valid (tmp.gain[i], tmp.offset[i]))
+            return -1;
+
+    memcpy(cal, &tmp, sizeof(tmp));
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// gain/offset 범위 확인. 32 bits 변환(cal_mv, cal_convert)이 overflow 되지 않는 값인지 확인함.
+// return 1 : 사용 가능, 0 : 범위 밖
+//------------------------------------------------------------------------------
+int cal_valid (int gain, int offset)
+{
+    long long off = offset;
+
+    if ((gain <= 0) || (gain >= CAL_GAIN_MAX))
+        return 0;
+    return ((off < 0 ? -off : off) + (long long)CAL_RAW_MAX * gain) <= INT32_MAX;
+}
+
+//------------------------------------------------------------------------------
+void cal_reset (struct adc_cal *cal)
+{
+    int i;
+
+    for (i = 0; i < ADC_CHIP_CNT * ADC_CH_CNT; i++) {
+        cal->gain  [i] = ADC_CAL_GAIN_IDEAL;
+        cal->offset[i] = 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+// 1개 chip/channel(idx) 변환
+//------------------------------------------------------------------------------
+int cal_mv (const struct adc_cal *cal, int idx, unsigned short raw)
+{
+    return ((short)raw * cal->gain[idx] + cal->offset[idx]) >> 16;
+}
+
+//------------------------------------------------------------------------------
+// chip/channel 순서의 raw[cnt]를 mv[cnt]로 변환. (snapshot 전체 = 48)
+//------------------------------------------------------------------------------
+void cal_convert (const struct adc_cal *cal, const unsigned short *raw, int *mv, int cnt)
+{
+    int i = 0;
+
+#if defined (__ARM_NEON)
+    for (; i + 4 <= cnt; i += 4) {
+        int32x4_t r = vmovl_s16(vld1_s16((const int16_t *)&raw[i]));
+        int32x4_t v = vmlaq_s32(vld1q_s32(&cal->offset[i]), r, vld1q_s32(&cal->gain[i]));
+        vst1q_s32(&mv[i], vshrq_n_s32(v, 16));
+    }
+#endif
+    for (; i < cnt; i++)
+        mv[i] = ((short)raw[i] * cal->gain[i] + cal->offset[i]) >> 16;
+}
+
+//------------------------------------------------------------------------------
+// 1개 chip/channel의 raw[n]을 변환. out = (raw * gain + offset) >> 16 (64 bits 계산)
+// 결과는 32 bits 범위이므로 SSE2에서는 64 bits logical shift 후 하위 32 bits만 사용함.
+// SSE2에는 signed 32 x 32 곱셈이 없으므로 raw(int16) + 32768(unsigned)로 곱한 후
+// offset에서 32768 * gain을 빼서 보정함.
+//------------------------------------------------------------------------------
+static void cal_convert_pin (int gain, long long offset, const unsigned short *raw, int *out, int n)
+{
+    int i = 0;
+
+#if defined (__ARM_NEON)
+    int64x2_t vo = vdupq_n_s64(offset);
+    int32x2_t vg = vdup_n_s32(gain);
+
+    for (; i + 4 <= n; i += 4) {
+        int32x4_t r  = vmovl_s16(vld1_s16((const int16_t *)&raw[i]));
+        int64x2_t lo = vmlal_s32(vo, vget_low_s32 (r), vg);
+        int64x2_t hi = vmlal_s32(vo, vget_high_s32(r), vg);
+        vst1q_s32(&out[i], vcombine_s32(vshrn_n_s64(lo, 16), vshrn_n_s64(hi, 16)));
+    }
+#elif defined (__SSE2__)
+    __m128i vg = _mm_set1_epi32(gain), vo = _mm_set1_epi64x(offset - 32768LL * gain);
+    __m128i lo32 = _mm_set_epi32(0, -1, 0, -1), bias = _mm_set1_epi16((short)0x8000);
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i r  = _mm_unpacklo_epi16(_mm_xor_si128(_mm_loadl_epi64((const __m128i *)&raw[i]), bias),
+                                        _mm_setzero_si128());
+        __m128i ev = _mm_srli_epi64(_mm_add_epi64(_mm_mul_epu32(r, vg), vo), 16);
+        __m128i od = _mm_srli_epi64(_mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(r, 32), vg), vo), 16);
+        _mm_storeu_si128((__m128i *)&out[i], _mm_or_si128(_mm_and_si128(ev, lo32),
+                                                          _mm_slli_epi64(od, 32)));
+    }
+#endif
+    for (; i < n; i++)
+        out[i] = (int)(((long long)(short)raw[i] * gain + offset) >> 16);
+}
+
+//------------------------------------------------------------------------------
+// 모든 chip/channel을 ideal 값으로 초기화
+//------------------------------------------------------------------------------
+int adc_board_cal_reset (adc_board_t *b)
+{
+    if (b == NULL)
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    cal_reset (&b->cal);
+    pthread_mutex_unlock(&b->lock);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// pin handle의 gain/offset(Q16) 설정. return -1 : 잘못된 handle 또는 값 (cal_valid)
+//------------------------------------------------------------------------------
+int adc_board_cal_set (adc_board_t *b, adc_pin_t pin, int gain, int offset)
+{
+    if ((b == NULL) || (pin >= ADC_CHIP_CNT * ADC_CH_CNT))
+        return -1;
+    if (!cal_valid (gain, offset))
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    b->cal.gain  [pin] = gain;
+    b->cal.offset[pin] = offset;
+    pthread_mutex_unlock(&b->lock);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// Bulk conversion. 1개 pin의 raw code[n](stream, burst read 결과)을 mV/uV로 변환함.
+// return : 변환한 수, -1 : 잘못된 handle
+//------------------------------------------------------------------------------
+int adc_board_conv_mv (adc_board_t *b, adc_pin_t pin, const unsigned short *raw, int *mv, int n)
+{
+    int gain, offset;
+
+    if ((b == NULL) || (raw == NULL) || (mv == NULL) || (n < 0))
+        return -1;
+    if (pin == ADC_PIN_NC) {
+        memset(mv, 0, sizeof(int) * n);
+        return n;
+    }
+    if (pin >= ADC_CHIP_CNT * ADC_CH_CNT)
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    gain = b->cal.gain[pin], offset = b->cal.offset[pin];
+    pthread_mutex_unlock(&b->lock);
+
+    cal_convert_pin (gain, offset, raw, mv, n);
+    return n;
+}
+
+//------------------------------------------------------------------------------
+int adc_board_conv_uv (adc_board_t *b, adc_pin_t pin, const unsigned short *raw, int *uv, int n)
+{
+    int gain, offset;
+
+    if ((b == NULL) || (raw == NULL) || (uv == NULL) || (n < 0))
+        return -1;
+    if (pin == ADC_PIN_NC) {
+        memset(uv, 0, sizeof(int) * n);
+        return n;
+    }
+    if (pin >= ADC_CHIP_CNT * ADC_CH_CNT)
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    gain = b->cal.gain[pin], offset = b->cal.offset[pin];
+    pthread_mutex_unlock(&b->lock);
+
+    cal_convert_pin (gain * 1000, offset * 1000LL, raw, uv, n);
+    return n;
+}
+
+//------------------------------------------------------------------------------
+// calibration file(text/binary) load. file에 없는 chip/channel은 현재 값을 유지함.
+// return 0 : success, -1 : error (현재 값 유지)
+//------------------------------------------------------------------------------
+int adc_board_cal_load (adc_board_t *b, const char *fname)
+{
+    struct adc_cal cal;
+    char magic [4];
+    FILE *fp;
+    int ret;
+
+    if ((b == NULL) || (fname == NULL))
+        return -1;
+
+    if ((fp = fopen(fname, "rb")) == NULL) {
+        fprintf(stderr, "%s : can't open %s\n", __func__, fname);
+        return -1;
+    }
+
+    pthread_mutex_lock(&b->lock);
+    cal = b->cal;
+    pthread_mutex_unlock(&b->lock);
+
+    if ((fread(magic, sizeof(magic), 1, fp) == 1) && !memcmp(magic, CAL_MAGIC, sizeof(magic))) {
+        ret = cal_load_bin (&cal, fp);
+    } else {
+        rewind(fp);
+        ret = cal_load_text (&cal, fp);
+    }
+    fclose(fp);
+
+    if (ret)
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    b->cal = cal;
+    pthread_mutex_unlock(&b->lock);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
@@ -0,0 +1,155 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_delta.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) change detection (delta report) for ODROID-JIG.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib_i2cadc.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Change detection. snapshot(adc_board/sampler/shm/log)을 받아서 마지막으로 보고한 값에서
+// deadband(raw code)보다 많이 변한 pin만 (pin, raw, mV, flags) list로 돌려줌.
+//
+//  - 비교 기준은 pin별 마지막으로 "보고한" raw이므로 deadband 이하의 느린 변화도 누적되면 보고됨.
+//  - sample의 유효 상태(ADC_FLAG_INVALID)가 바뀐 경우는 값과 관계없이 보고함.
+//  - 첫 update(또는 adc_delta_reset 이후)는 모든 pin을 보고함.
+//  - out[max]가 부족하면 남은 pin은 기준값을 바꾸지 않으므로 다음 update에서 보고됨.
+//  - snap->seq가 이전 update와 같으면(sampler/shm의 같은 scan) 비교 없이 0을 돌려줌.
+//
+// context는 consumer별로 만들어서 사용함. (lock 없음, thread 1개)
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+#define SCAN_CH_MAX     (ADC_CHIP_CNT * ADC_CH_CNT)
+
+struct adc_delta {
+    short               ref      [SCAN_CH_MAX];     // 마지막으로 보고한 raw (bipolar : int16)
+    short               band     [SCAN_CH_MAX];     // deadband, < 0 : 보고 안함
+    unsigned char       ref_flags[SCAN_CH_MAX];     // 마지막으로 보고한 flags & ADC_FLAG_INVALID
+    unsigned char       ref_ok   [SCAN_CH_MAX];     // 기준값 있음
+    unsigned int        seq;                        // 마지막 update의 snapshot seq
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+        struct adc_delta *adc_delta_create (int deadband);
+        void    adc_delta_destroy       (struct adc_delta *d);
+        int     adc_delta_set_deadband  (struct adc_delta *d, adc_pin_t pin, int deadband);
+        void    adc_delta_reset         (struct adc_delta *d);
+        int     adc_delta_update        (struct adc_delta *d, const struct adc_snapshot *snap,
+                                         struct adc_change *out, int max);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// 모든 pin의 deadband(raw code, < 0 : 모든 pin 보고 안함)로 context 생성.
+//------------------------------------------------------------------------------
+struct adc_delta *adc_delta_create (int deadband)
+{
+    struct adc_delta *d;
+    int i;
+
+    if ((d = calloc(1, sizeof(struct adc_delta))) == NULL)
+        return NULL;
+
+    deadband = (deadband > 4095) ? 4095 : (deadband < 0) ? -1 : deadband;
+    for (i = 0; i < SCAN_CH_MAX; i++)
+        d->band[i] = deadband;
+    return d;
+}
+
+//------------------------------------------------------------------------------
+void adc_delta_destroy (struct adc_delta *d)
+{
+    free (d);
+}
+
+//------------------------------------------------------------------------------
+// pin의 deadband. |raw - 마지막 보고값| > deadband 이면 보고함. (0 : 값이 바뀌면 보고)
+// deadband < 0 이면 pin을 보고하지 않음. return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+int adc_delta_set_deadband (struct adc_delta *d, adc_pin_t pin, int deadband)
+{
+    if ((d == NULL) || (pin >= SCAN_CH_MAX))
+        return -1;
+
+    d->band[pin] = (deadband > 4095) ? 4095 : (deadband < 0) ? -1 : deadband;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// 기준값 삭제. 다음 update에서 모든 pin을 보고함.
+//------------------------------------------------------------------------------
+void adc_delta_reset (struct adc_delta *d)
+{
+    if (d == NULL)
+        return;
+
+    memset(d->ref_ok, 0, sizeof(d->ref_ok));
+    d->seq = 0;
+}
+
+//------------------------------------------------------------------------------
+// snap에서 변한 pin을 chip/channel 순서로 out[max]에 저장함.
+// return : 저장한 수 (0 : 변한 pin 없음 또는 같은 scan), -1 : error
+//------------------------------------------------------------------------------
+int adc_delta_update (struct adc_delta *d, const struct adc_snapshot *snap,
+                      struct adc_change *out, int max)
+{
+    const unsigned short *raw;
+    const unsigned char *flags;
+    const int *mv;
+    int i, diff, inv, n = 0;
+
+    if ((d == NULL) || (snap == NULL) || (out == NULL) || (max < 0))
+        return -1;
+
+    if (snap->seq && (snap->seq == d->seq))
+        return 0;
+    d->seq = snap->seq;
+
+    // raw/mv/flags[chip][ch]는 chip/channel 순서의 연속된 배열
+    raw   = &snap->raw[0][0];
+    mv    = &snap->mv[0][0];
+    flags = &snap->flags[0][0];
+
+    for (i = 0; (i < SCAN_CH_MAX) && (n < max); i++) {
+        if (d->band[i] < 0)
+            continue;
+
+        inv  = flags[i] & ADC_FLAG_INVALID;
+        diff = (short)raw[i] - d->ref[i];
+        if (d->ref_ok[i] && (inv == d->ref_flags[i]) &&
+            (inv || ((diff <= d->band[i]) && (diff >= -d->band[i]))))
+            continue;
+
+        d->ref[i]       = (short)raw[i];
+        d->ref_flags[i] = inv;
+        d->ref_ok[i]    = 1;
+
+        out[n].pin   = i;
+        out[n].raw   = raw[i];
+        out[n].flags = flags[i];
+        out[n].mv    = mv[i];
+        n++;
+    }
+    return n;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
@@ -0,0 +1,626 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_desc.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) board description (chip address, header pin map).
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "lib_i2cadc.h"
+#include "lib_i2cadc_priv.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Board description. chip I2C address와 header pin -> chip/channel 연결 정보.
+//
+// 기본값은 아래의 ODROID-JIG ADC board table이며, jig revision(다른 chip 수/address,
+// header 배치)은 adc_desc_load()로 text file을 읽어서 library build 없이 사용함.
+//
+//  # comment
+//  chip   0x08 0x09 0x0A 0x0B 0x18 0x19        chip index 0 부터 I2C address (최대 ADC_CHIP_CNT)
+//  header CON1 0.0 0.1 1.0 0.2 1.1 - 1.2       header pin 1 부터 chip.channel, '-' = 미사용 pin
+//  header CON1 1.3 - 1.4 ...                   같은 header를 이어서 쓰면 pin이 추가됨
+//
+// load시 모든 header pin을 header 순서의 연속된 pin handle 배열(flat index)로 만들고
+// header name은 hash table로 찾으므로, header 수와 관계없이 pin name 검색은 hash 1회 +
+// 문자열 비교 1회이며 pin은 배열 index로 바로 찾음. (chip/channel -> pin name도 table)
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+#define	ARRARY_SIZE(x)	(sizeof(x) / sizeof(x[0]))
+
+#define DESC_HDR_MAX    32
+#define DESC_HDR_LEN    12              // header name 최대 11자
+#define DESC_PIN_MAX    1024            // 전체 header pin 수
+#define DESC_HASH_SIZE  64              // 2의 승수, DESC_HDR_MAX * 2
+#define DESC_NAME_LEN   20              // "header.pin"
+#define DESC_CH_MAX     (ADC_CHIP_CNT * ADC_CH_CNT)
+
+struct desc_hdr {
+    char                name [DESC_HDR_LEN];
+    unsigned char       len;
+    unsigned short      cnt;            // header pin 수 (pin 0 제외)
+    unsigned short      first;          // pin 1의 pin[] index
+};
+
+struct adc_desc {
+    int                 chip_cnt;
+    unsigned char       addr [ADC_CHIP_CNT];
+    int                 hdr_cnt;
+    struct desc_hdr     hdr  [DESC_HDR_MAX];
+    // header name hash (open addressing), 값은 hdr index + 1 (0 = 없음)
+    unsigned char       hash [DESC_HASH_SIZE];
+    // header pin handle. header별로 연속 (hdr.first ~ hdr.first + hdr.cnt - 1)
+    int                 pin_cnt;
+    adc_pin_t           pin  [DESC_PIN_MAX];
+    // chip/channel이 연결된 첫 header pin name ("" : 연결 안됨)
+    char                name [DESC_CH_MAX][DESC_NAME_LEN];
+    // 이전에 load한 description (DescList, 해제하지 않음)
+    struct adc_desc     *prev;
+};
+
+//------------------------------------------------------------------------------
+// 기본 board description : ODROID-JIG ADC board
+//------------------------------------------------------------------------------
+enum {
+    CHIP_ADC0 = 0,
+    CHIP_ADC1,
+    CHIP_ADC2,
+    CHIP_ADC3,
+    CHIP_ADC4,
+    CHIP_ADC5,
+    NOT_USED,
+};
+
+
+// Header pin info CON1, P1.1 ~ P1.6, P3 port control.
+struct pin_info {
+    const char *name;
+    unsigned char pin_num;
+    unsigned char adc_idx;
+    unsigned char ch_idx;
+};
+
+static const struct pin_info HEADER_CON1[] = {
+    { "CON1.0" ,   0, NOT_USED , 0},    // Header Pin 0
+
+    { "CON1.1" ,   1, CHIP_ADC0, 0},    // Header Pin 1 Info
+    { "CON1.2" ,   2, CHIP_ADC0, 1},    // Header Pin 2 Info
+    { "CON1.3" ,   3, CHIP_ADC1, 0},
+    { "CON1.4" ,   4, CHIP_ADC0, 2},
+    { "CON1.5" ,   5, CHIP_ADC1, 1},
+    { "CON1.6" ,   6, NOT_USED , 0},
+    { "CON1.7" ,   7, CHIP_ADC1, 2},
+    { "CON1.8" ,   8, CHIP_ADC1, 3},
+    { "CON1.9" ,   9, NOT_USED , 0},
+    { "CON1.10",  10, CHIP_ADC1, 4},
+
+    { "CON1.11",  11, CHIP_ADC1, 5},
+    { "CON1.12",  12, CHIP_ADC1, 6},
+    { "CON1.13",  13, CHIP_ADC1, 7},
+    { "CON1.14",  14, NOT_USED , 0},
+    { "CON1.15",  15, CHIP_ADC2, 0},
+    { "CON1.16",  16, CHIP_ADC2, 1},
+    { "CON1.17",  17, CHIP_ADC0, 3},
+    { "CON1.18",  18, CHIP_ADC2, 2},
+    { "CON1.19",  19, CHIP_ADC2, 3},
+    { "CON1.20",  20, NOT_USED , 0},
+
+    { "CON1.21",  21, CHIP_ADC2, 4},
+    { "CON1.22",  22, CHIP_ADC2, 5},
+    { "CON1.23",  23, CHIP_ADC2, 6},
+    { "CON1.24",  24, CHIP_ADC2, 7},
+    { "CON1.25",  25, NOT_USED , 0},
+    { "CON1.26",  26, CHIP_ADC3, 0},
+    { "CON1.27",  27, CHIP_ADC3, 1},
+    { "CON1.28",  28, CHIP_ADC3, 2},
+    { "CON1.29",  29, CHIP_ADC3, 3},
+    { "CON1.30",  30, NOT_USED , 0},
+
+    { "CON1.31",  31, CHIP_ADC3, 4},
+    { "CON1.32",  32, CHIP_ADC3, 5},
+    { "CON1.33",  33, CHIP_ADC3, 6},
+    { "CON1.34",  34, NOT_USED , 0},
+    { "CON1.35",  35, CHIP_ADC3, 7},
+    { "CON1.36",  36, CHIP_ADC4, 0},
+    { "CON1.37",  37, NOT_USED , 0},
+    { "CON1.38",  38, CHIP_ADC0, 4},
+    { "CON1.39",  39, NOT_USED , 0},
+    { "CON1.40",  40, NOT_USED , 0},
+};
+
+static const struct pin_info HEADER_P3[] = {
+    { "P3.0" ,  0, NOT_USED , 0},   // Header Pin 0
+    { "P3.1" ,  1, NOT_USED , 0},   // Header Pin 1 Info
+    { "P3.2" ,  2, CHIP_ADC5, 0},   // Header Pin 2 Info
+    { "P3.3" ,  3, CHIP_ADC5, 1},
+    { "P3.4" ,  4, NOT_USED , 0},
+    { "P3.5" ,  5, CHIP_ADC5, 2},
+    { "P3.6" ,  6, CHIP_ADC5, 3},
+    { "P3.7" ,  7, NOT_USED , 0},
+    { "P3.8" ,  8, CHIP_ADC5, 4},
+    { "P3.9" ,  9, CHIP_ADC5, 5},
+    { "P3.10", 10, NOT_USED , 0},
+};
+
+static const struct pin_info HEADER_P13[] = {
+    { "P13.0", 0, NOT_USED , 0},    // Header Pin 0
+    { "P13.1", 1, NOT_USED , 0},    // Header Pin 1 Info
+    { "P13.2", 2, CHIP_ADC4, 1},    // Header Pin 2 Info
+    { "P13.3", 3, CHIP_ADC0, 5},
+    { "P13.4", 4, CHIP_ADC4, 2},
+    { "P13.5", 5, CHIP_ADC4, 3},
+    { "P13.6", 6, CHIP_ADC4, 4},
+    { "P13.7", 7, CHIP_ADC4, 5},
+};
+
+static const struct pin_info HEADER_P1_1[] = {
+    { "P1_1.0", 0, NOT_USED , 0},   // Header Pin 0
+    { "P1_1.1", 1, CHIP_ADC0, 7},   // Header Pin 1 Info
+    { "P1_1.2", 2, CHIP_ADC0, 6},   // Header Pin 2 Info
+    { "P1_1.3", 3, CHIP_ADC0, 5},
+    { "P1_1.4", 4, CHIP_ADC0, 4},
+    { "P1_1.5", 5, CHIP_ADC0, 3},
+    { "P1_1.6", 6, CHIP_ADC0, 2},
+    { "P1_1.7", 7, CHIP_ADC0, 1},
+    { "P1_1.8", 8, CHIP_ADC0, 0},
+};
+
+static const struct pin_info HEADER_P1_2[] = {
+    { "P1_2.0", 0, NOT_USED , 0},   // Header Pin 0
+    { "P1_2.1", 1, CHIP_ADC1, 7},   // Header Pin 1 Info
+    { "P1_2.2", 2, CHIP_ADC1, 6},   // Header Pin 2 Info
+    { "P1_2.3", 3, CHIP_ADC1, 5},
+    { "P1_2.4", 4, CHIP_ADC1, 4},
+    { "P1_2.5", 5, CHIP_ADC1, 3},
+    { "P1_2.6", 6, CHIP_ADC1, 2},
+    { "P1_2.7", 7, CHIP_ADC1, 1},
+    { "P1_2.8", 8, CHIP_ADC1, 0},
+};
+
+static const struct pin_info HEADER_P1_3[] = {
+    { "P1_3.0", 0, NOT_USED , 0},   // Header Pin 0
+    { "P1_3.1", 1, CHIP_ADC2, 7},   // Header Pin 1 Info
+    { "P1_3.2", 2, CHIP_ADC2, 6},   // Header Pin 2 Info
+    { "P1_3.3", 3, CHIP_ADC2, 5},
+    { "P1_3.4", 4, CHIP_ADC2, 4},
+    { "P1_3.5", 5, CHIP_ADC2, 3},
+    { "P1_3.6", 6, CHIP_ADC2, 2},
+    { "P1_3.7", 7, CHIP_ADC2, 1},
+    { "P1_3.8", 8, CHIP_ADC2, 0},
+};
+
+static const struct pin_info HEADER_P1_4[] = {
+    { "P1_4.0", 0, NOT_USED , 0},   // Header Pin 0
+    { "P1_4.1", 1, CHIP_ADC3, 7},   // Header Pin 1 Info
+    { "P1_4.2", 2, CHIP_ADC3, 6},   // Header Pin 2 Info
+    { "P1_4.3", 3, CHIP_ADC3, 5},
+    { "P1_4.4", 4, CHIP_ADC3, 4},
+    { "P1_4.5", 5, CHIP_ADC3, 3},
+    { "P1_4.6", 6, CHIP_ADC3, 2},
+    { "P1_4.7", 7, CHIP_ADC3, 1},
+    { "P1_4.8", 8, CHIP_ADC3, 0},
+};
+
+static const struct pin_info HEADER_P1_5[] = {
+    { "P1_5.0", 0, NOT_USED , 0},   // Header Pin 0
+    { "P1_5.1", 1, CHIP_ADC4, 7},   // Header Pin 1 Info
+    { "P1_5.2", 2, CHIP_ADC4, 6},   // Header Pin 2 Info
+    { "P1_5.3", 3, CHIP_ADC4, 5},
+    { "P1_5.4", 4, CHIP_ADC4, 4},
+    { "P1_5.5", 5, CHIP_ADC4, 3},
+    { "P1_5.6", 6, CHIP_ADC4, 2},
+    { "P1_5.7", 7, CHIP_ADC4, 1},
+    { "P1_5.8", 8, CHIP_ADC4, 0},
+};
+
+static const struct pin_info HEADER_P1_6[] = {
+    { "P1_6.0", 0, NOT_USED , 0},   // Header Pin 0
+    { "P1_6.1", 1, CHIP_ADC5, 7},   // Header Pin 1 Info
+    { "P1_6.2", 2, CHIP_ADC5, 6},   // Header Pin 2 Info
+    { "P1_6.3", 3, CHIP_ADC5, 5},
+    { "P1_6.4", 4, CHIP_ADC5, 4},
+    { "P1_6.5", 5, CHIP_ADC5, 3},
+    { "P1_6.6", 6, CHIP_ADC5, 2},
+    { "P1_6.7", 7, CHIP_ADC5, 1},
+    { "P1_6.8", 8, CHIP_ADC5, 0},
+};
+
+//------------------------------------------------------------------------------
+// Header list. cnt = header pin 수 (pin 0 제외)
+//------------------------------------------------------------------------------
+struct header_info {
+    const char              *name;
+    unsigned char           cnt;
+    const struct pin_info   *pin;
+};
+
+#define HEADER_INFO(n, t)   { n, ARRARY_SIZE(t) - 1, t }
+
+static const struct header_info HEADERS[] = {
+    HEADER_INFO("CON1", HEADER_CON1),
+    HEADER_INFO("P3"  , HEADER_P3  ),
+    HEADER_INFO("P13" , HEADER_P13 ),
+    HEADER_INFO("P1_1", HEADER_P1_1),
+    HEADER_INFO("P1_2", HEADER_P1_2),
+    HEADER_INFO("P1_3", HEADER_P1_3),
+    HEADER_INFO("P1_4", HEADER_P1_4),
+    HEADER_INFO("P1_5", HEADER_P1_5),
+    HEADER_INFO("P1_6", HEADER_P1_6),
+};
+
+//------------------------------------------------------------------------------
+// 현재 사용중인 description (NULL : DefaultDesc)
+// desc_find, adc_pin_name 등이 return한 pointer를 lock 없이 계속 사용할 수 있도록
+// load된 description은 process 종료시까지 해제하지 않음. (DescList에 prev로 연결)
+//------------------------------------------------------------------------------
+static struct adc_desc DefaultDesc;
+static pthread_once_t DefaultOnce = PTHREAD_ONCE_INIT;
+static struct adc_desc *Desc = NULL;
+static struct adc_desc *DescList = NULL;
+static pthread_mutex_t DescLock = PTHREAD_MUTEX_INITIALIZER;
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  unsigned int desc_hash          (const char *name, int len);
+static  struct desc_hdr *desc_header    (const struct adc_desc *d, const char *name, int len);
+static  struct desc_hdr *desc_add_header(struct adc_desc *d, const char *name);
+static  int     desc_add_pin            (struct adc_desc *d, struct desc_hdr *hdr, adc_pin_t pin);
+static  void    desc_index              (struct adc_desc *d);
+static  void    desc_default            (void);
+static  const struct adc_desc *desc_get (void);
+static  int     parse_chip              (struct adc_desc *d, char *tok);
+static  adc_pin_t parse_pin             (const struct adc_desc *d, const char *tok);
+static  int     parse_line              (struct adc_desc *d, char *line);
+
+        const adc_pin_t *desc_find      (const char *name, const char **hdr_name, int *pin_no, int *p_cnt);
+        int     desc_chips              (unsigned char *addr);
+
+        int     adc_desc_load           (const char *fname);
+        const char *adc_desc_header     (int idx);
+        const char *adc_pin_name        (adc_pin_t pin);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// header name hash (FNV-1a, 대소문자 무시)
+//------------------------------------------------------------------------------
+static unsigned int desc_hash (const char *name, int len)
+{
+    unsigned int h = 2166136261u;
+
+    while (len--)
+        h = (h ^ toupper((unsigned char)*name++)) * 16777619u;
+    return h;
+}
+
+//------------------------------------------------------------------------------
+// header name(길이 len, 대소문자 무시)의 header. return NULL : 없음
+//------------------------------------------------------------------------------
+static struct desc_hdr *desc_header (const struct adc_desc *d, const char *name, int len)
+{
+    const struct desc_hdr *hdr;
+    unsigned int i;
+
+    if ((len <= 0) || (len >= DESC_HDR_LEN))
+        return NULL;
+
+    for (i = desc_hash (name, len); d->hash [i & (DESC_HASH_SIZE - 1)]; i++) {
+        hdr = &d->hdr [d->hash [i & (DESC_HASH_SIZE - 1)] - 1];
+        if ((hdr->len == len) && !strncasecmp(hdr->name, name, len))
+            return (struct desc_hdr *)hdr;
+    }
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+// header 추가 (pin은 desc_add_pin으로 추가). return NULL : 잘못된 이름, header 수 초과
+//------------------------------------------------------------------------------
+static struct desc_hdr *desc_add_header (struct adc_desc *d, const char *name)
+{
+    struct desc_hdr *hdr;
+    int len = strlen(name);
+    unsigned int i;
+
+    if ((len <= 0) || (len >= DESC_HDR_LEN) || strchr(name, '.') || (d->hdr_cnt >= DESC_HDR_MAX))
+        return NULL;
+
+    hdr = &d->hdr [d->hdr_cnt++];
+    strcpy(hdr->name, name);
+    hdr->len   = len;
+    hdr->cnt   = 0;
+    hdr->first = d->pin_cnt;
+
+    for (i = desc_hash (name, len); d->hash [i & (DESC_HASH_SIZE - 1)]; i++)
+        ;
+    d->hash [i & (DESC_HASH_SIZE - 1)] = d->hdr_cnt;
+    return hdr;
+}
+
+//------------------------------------------------------------------------------
+// 마지막 header에 pin 추가. return 0 : success, -1 : pin 수 초과
+//------------------------------------------------------------------------------
+static int desc_add_pin (struct adc_desc *d, struct desc_hdr *hdr, adc_pin_t pin)
+{
+    if ((d->pin_cnt >= DESC_PIN_MAX) || (hdr->cnt >= ADC_HEADER_PINS))
+        return -1;
+
+    d->pin [d->pin_cnt++] = pin;
+    hdr->cnt++;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// chip/channel -> pin name table. (header 순서로 처음 연결된 pin)
+//------------------------------------------------------------------------------
+static void desc_index (struct adc_desc *d)
+{
+    const struct desc_hdr *hdr;
+    int i, j;
+    adc_pin_t pin;
+
+    memset(d->name, 0, sizeof(d->name));
+    for (i = 0; i < d->hdr_cnt; i++) {
+        hdr = &d->hdr [i];
+        for (j = 0; j < hdr->cnt; j++) {
+            pin = d->pin [hdr->first + j];
+            if ((pin != ADC_PIN_NC) && !d->name [pin][0])
+                snprintf(d->name [pin], DESC_NAME_LEN, "%s.%d", hdr->name, j + 1);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// 기본 description (HEADERS table)
+//------------------------------------------------------------------------------
+static void desc_default (void)
+{
+    struct adc_desc *d = &DefaultDesc;
+    const struct pin_info *p;
+    struct desc_hdr *hdr;
+    int i, j;
+
+    d->chip_cnt = ADC_CHIP_CNT;
+    memcpy(d->addr, ADC_I2C_ADDR, ADC_CHIP_CNT);
+
+    for (i = 0; i < (int)ARRARY_SIZE(HEADERS); i++) {
+        hdr = desc_add_header (d, HEADERS[i].name);
+        for (j = 1; j <= HEADERS[i].cnt; j++) {
+            p = &HEADERS[i].pin[j];
+            desc_add_pin (d, hdr, (p->adc_idx == NOT_USED) ? ADC_PIN_NC :
+                                  (adc_pin_t)(p->adc_idx * ADC_CH_CNT + p->ch_idx));
+        }
+    }
+    desc_index (d);
+}
+
+//------------------------------------------------------------------------------
+static const struct adc_desc *desc_get (void)
+{
+    const struct adc_desc *d = __atomic_load_n(&Desc, __ATOMIC_ACQUIRE);
+
+    if (d)
+        return d;
+
+    pthread_once(&DefaultOnce, desc_default);
+    return &DefaultDesc;
+}
+
+//------------------------------------------------------------------------------
+// 'chip' line의 address 1개. return 0 : success, -1 : 잘못된 address, chip 수 초과
+//------------------------------------------------------------------------------
+static int parse_chip (struct adc_desc *d, char *tok)
+{
+    char *end;
+    long addr = strtol(tok, &end, 0);
+    int i;
+
+    if (*end || (addr < 0x08) || (addr > 0x77) || (d->chip_cnt >= ADC_CHIP_CNT))
+        return -1;
+
+    for (i = 0; i < d->chip_cnt; i++)
+        if (d->addr [i] == addr)
+            return -1;
+
+    d->addr [d->chip_cnt++] = addr;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// header pin "chip.channel" 또는 "-". return : pin handle, ADC_PIN_NC, 0xFFFE : error
+//------------------------------------------------------------------------------
+static adc_pin_t parse_pin (const struct adc_desc *d, const char *tok)
+{
+    char *end;
+    long c, ch;
+
+    if (!strcmp(tok, "-"))
+        return ADC_PIN_NC;
+
+    c = strtol(tok, &end, 10);
+    if ((end == tok) || (*end != '.') || (c < 0) || (c >= d->chip_cnt))
+        return 0xFFFE;
+
+    tok = end + 1;
+    ch = strtol(tok, &end, 10);
+    if ((end == tok) || *end || (ch < 0) || (ch >= ADC_CH_CNT))
+        return 0xFFFE;
+
+    return (adc_pin_t)(c * ADC_CH_CNT + ch);
+}
+
+//------------------------------------------------------------------------------
+// description 1 line. return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+static int parse_line (struct adc_desc *d, char *line)
+{
+    struct desc_hdr *hdr;
+    char *save, *tok, *p;
+    adc_pin_t pin;
+
+    if ((p = strchr(line, '#')) != NULL)
+        *p = 0;
+
+    if ((tok = strtok_r(line, " \t\r\n", &save)) == NULL)
+        return 0;
+
+    if (!strcasecmp(tok, "chip")) {
+        while ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL)
+            if (parse_chip (d, tok))
+                return -1;
+        return 0;
+    }
+
+    if (strcasecmp(tok, "header") || ((tok = strtok_r(NULL, " \t\r\n", &save)) == NULL))
+        return -1;
+
+    // 같은 header는 마지막 header인 경우에만 이어서 추가 (header pin은 연속된 배열)
+    if ((hdr = desc_header (d, tok, strlen(tok))) != NULL) {
+        if (hdr != &d->hdr [d->hdr_cnt - 1])
+            return -1;
+    } else if ((hdr = desc_add_header (d, tok)) == NULL)
+        return -1;
+
+    while ((tok = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+        if ((pin = parse_pin (d, tok)) == 0xFFFE)
+            return -1;
+        if (desc_add_pin (d, hdr, pin))
+            return -1;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// pin name(CON1.1, con1...)을 header name과 pin 번호로 분리하여 header pin handle을 찾음.
+// pin 번호가 없거나 범위를 벗어나면 header 전체 pin을 돌려줌. (p_cnt = 0 : 없음)
+// hdr_name != NULL이면 header name을 저장함.
+//------------------------------------------------------------------------------
+const adc_pin_t *desc_find (const char *name, const char **hdr_name, int *pin_no, int *p_cnt)
+{
+    const struct adc_desc *d = desc_get ();
+    const struct desc_hdr *hdr;
+    const char *dot = strchr(name, '.');
+    int len = dot ? (int)(dot - name) : (int)strlen(name);
+
+    *pin_no = 0, *p_cnt = 0;
+    if ((hdr = desc_header (d, name, len)) == NULL)
+        return NULL;
+
+    for (dot = dot ? dot + 1 : NULL; dot && isdigit(*dot) && (*pin_no < 256); dot++)
+        *pin_no = *pin_no * 10 + (*dot - '0');
+
+    *pin_no = (*pin_no <= hdr->cnt) ? *pin_no : 0;
+    *p_cnt  = *pin_no ? 1 : hdr->cnt;
+    if (hdr_name)
+        *hdr_name = hdr->name;
+
+    return &d->pin [hdr->first + (*pin_no ? *pin_no - 1 : 0)];
+}
+
+//------------------------------------------------------------------------------
+// 현재 description의 chip I2C address를 addr[ADC_CHIP_CNT]에 복사함. return : chip 수
+//------------------------------------------------------------------------------
+int desc_chips (unsigned char *addr)
+{
+    const struct adc_desc *d = desc_get ();
+
+    memcpy(addr, d->addr, ADC_CHIP_CNT);
+    return d->chip_cnt;
+}
+
+//------------------------------------------------------------------------------
+// board description file을 읽어서 현재 description으로 사용함. fname == NULL : 기본값
+// 이후 open하는 board와 pin name API(adc_pin_resolve 등)에 적용됨.
+// 이전 description은 해제하지 않으므로 이미 가져온 header/pin name은 계속 유효함.
+// (load 1회당 struct adc_desc 1개의 memory가 유지됨)
+// return : header 수, -1 : error (현재 description 유지)
+//------------------------------------------------------------------------------
+int adc_desc_load (const char *fname)
+{
+    struct adc_desc *d;
+    char *line = NULL;
+    size_t size = 0;
+    int lineno = 0, ret = 0;
+    FILE *fp;
+
+    if (fname == NULL) {
+        d = NULL;
+        goto out;
+    }
+
+    if ((fp = fopen(fname, "r")) == NULL) {
+        fprintf(stderr, "%s : %s open error : %s\n", __func__, fname, strerror(errno));
+        return -1;
+    }
+
+    if ((d = calloc(1, sizeof(struct adc_desc))) == NULL) {
+        fclose (fp);
+        return -1;
+    }
+
+    while (!ret && (getline(&line, &size, fp) > 0)) {
+        lineno++;
+        ret = parse_line (d, line);
+    }
+    free (line);
+    fclose (fp);
+
+    if (ret || !d->chip_cnt || !d->hdr_cnt) {
+        fprintf(stderr, "%s : %s:%d wrong board description\n", __func__, fname, lineno);
+        free (d);
+        return -1;
+    }
+    desc_index (d);
+out:
+    pthread_mutex_lock(&DescLock);
+    if (d != NULL) {
+        d->prev  = DescList;
+        DescList = d;
+    }
+    __atomic_store_n(&Desc, d, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&DescLock);
+
+    return desc_get ()->hdr_cnt;
+}
+
+//------------------------------------------------------------------------------
+// description의 idx번째 header name. return NULL : 없음 (idx >= header 수)
+//------------------------------------------------------------------------------
+const char *adc_desc_header (int idx)
+{
+    const struct adc_desc *d = desc_get ();
+
+    return ((idx < 0) || (idx >= d->hdr_cnt)) ? NULL : d->hdr [idx].name;
+}
+
+//------------------------------------------------------------------------------
+// pin handle이 연결된 header pin name (header 순서로 처음 찾은 pin, 예: "CON1.1")
+// return NULL : header에 연결되지 않은 chip/channel
+//------------------------------------------------------------------------------
+const char *adc_pin_name (adc_pin_t pin)
+{
+    const struct adc_desc *d = desc_get ();
+
+    if ((pin >= DESC_CH_MAX) || !d->name [pin][0])
+        return NULL;
+    return d->name [pin];
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
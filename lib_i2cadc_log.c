@@ -0,0 +1,658 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_log.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) binary capture log (record / mmap replay).
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lib_i2cadc.h"
+#include "lib_i2cadc_priv.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Binary capture log. 장시간(burn-in) capture를 위한 snapshot 기록 file.
+//
+//  file  = header (LOG_BLOCK) + block[n] (LOG_BLOCK 단위, mmap/seek이 가능하도록 고정 크기)
+//  header: magic, version, 시작 시간, chip/channel별 pin name, input mode, calibration
+//  block : block header(16) + keyframe + frame ...
+//          frame    = tag(1) + dt_ns(4, 이전 frame 기준) + [flags] + data
+//                     LOG_FULL   : 12 bits packed code (72)
+//                     LOG_DELTA8 : 이전 frame과의 차이 int8 x 48 (48)
+//                     LOG_DELTA4 : 이전 frame과의 차이 int4 x 48 (24)
+//          keyframe = block의 첫 frame, LOG_FULL (dt = 0, ts = block header의 ts0)
+//          flags    = tag & LOG_FLAGS인 경우 : flag가 있는 channel mask(8) + flag(ADC_FLAG_xxx)
+//                     x mask의 bit 수 (bus error 등이 없으면 생략)
+//
+//  - delta는 ADC_LOG_DELTA로 생성한 경우에만 사용하며 모든 channel의 차이가 범위 안일때 선택.
+//  - block은 다른 block 없이 decoding 가능(keyframe)하며 block의 ts0로 binary search 함.
+//  - block은 가득 차거나 close시 기록(1 block = 1 write)되므로 비정상 종료시 마지막 block은 없음.
+//  - 1 kHz, 24 시간 : 약 2.5 GB (delta4) ~ 6.7 GB (full)
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+#define LOG_MAGIC       "ADCLOG\0"
+#define LOG_VERSION     2
+#define LOG_BLOCK       4096
+#define LOG_CH_CNT      (ADC_CHIP_CNT * ADC_CH_CNT)
+#define LOG_PACK_SIZE   (LOG_CH_CNT * 3 / 2)
+#define LOG_NAME_LEN    12
+
+enum {
+    LOG_FULL = 1,
+    LOG_DELTA8,
+    LOG_DELTA4,
+};
+#define LOG_FLAGS       0x80        // tag : sample flags 포함
+#define LOG_FRAME_HDR   5           // tag + dt
+
+struct log_hdr {
+    char                magic [8];
+    uint32_t            version;
+    uint32_t            block_size;
+    uint32_t            ch_cnt;
+    uint32_t            flags;              // ADC_LOG_xxx
+    uint64_t            start_ns;           // 생성 시간 (CLOCK_MONOTONIC, frame ts와 같은 기준)
+    uint64_t            start_real_ns;      // 생성 시간 (CLOCK_REALTIME)
+    uint8_t             mode   [LOG_CH_CNT];                // ADC_MODE_xxx
+    char                name   [LOG_CH_CNT][LOG_NAME_LEN];  // header pin name ("" : 미사용)
+    int32_t             gain   [LOG_CH_CNT];                // calibration (Q16)
+    int32_t             offset [LOG_CH_CNT];
+};
+
+struct log_blk {
+    uint64_t            ts0;                // keyframe time
+    uint32_t            frame0;             // keyframe의 frame 번호 (0 ~)
+    uint16_t            frames;             // block의 frame 수 (keyframe 포함)
+    uint16_t            used;               // 사용한 byte (block header 포함)
+};
+
+// reader 위치 (block, block 안의 frame/offset, 마지막 frame의 code/time)
+struct log_pos {
+    unsigned int        blk;
+    unsigned int        idx;
+    unsigned int        off;
+    unsigned long long  ts;
+    unsigned short      code  [LOG_CH_CNT];
+    unsigned char       flags [LOG_CH_CNT];
+};
+
+struct adc_log {
+    int                 writer;
+    int                 fd;
+    struct log_hdr      hdr;
+    struct adc_cal      cal;
+    // writer : 기록중인 block
+    unsigned char       buf [LOG_BLOCK];
+    struct log_blk      blk;
+    unsigned int        frames;
+    unsigned long long  ts;
+    unsigned short      code [LOG_CH_CNT];
+    // reader : mmap된 file
+    const unsigned char *map;
+    size_t              map_size;
+    unsigned int        blocks;
+    struct log_pos      pos;
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  void    pack12                  (const unsigned short *code, unsigned char *p);
+static  void    unpack12                (const unsigned char *p, unsigned short *code);
+static  int     delta_type              (const int *d, int delta);
+static  int     write_all               (int fd, const void *buf, size_t len);
+static  int     block_flush             (struct adc_log *l);
+static  const struct log_blk *block_get (const struct adc_log *l, unsigned int blk, struct log_blk *bh);
+static  int     frame_next              (const struct adc_log *l, struct log_pos *pos);
+static  void    frame_out               (const struct adc_log *l, const struct log_pos *pos,
+                                         struct adc_snapshot *snap);
+
+        struct adc_log *adc_log_create  (adc_board_t *b, const char *fname, int flags);
+        int     adc_log_append          (struct adc_log *l, const struct adc_snapshot *snap);
+        struct adc_log *adc_log_open    (const char *fname);
+        int     adc_log_close           (struct adc_log *l);
+        int     adc_log_range           (struct adc_log *l, unsigned long long *first_ns,
+                                         unsigned long long *last_ns);
+        int     adc_log_seek            (struct adc_log *l, unsigned long long ts_ns);
+        int     adc_log_next            (struct adc_log *l, struct adc_snapshot *snap);
+        const char *adc_log_pin_name    (struct adc_log *l, adc_pin_t pin);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// 12 bits code 2개 -> 3 bytes
+//------------------------------------------------------------------------------
+static void pack12 (const unsigned short *code, unsigned char *p)
+{
+    int i;
+
+    for (i = 0; i < LOG_CH_CNT; i += 2, p += 3) {
+        p[0] = code[i] & 0xFF;
+        p[1] = ((code[i] >> 8) & 0x0F) | ((code[i + 1] & 0x0F) << 4);
+        p[2] = (code[i + 1] >> 4) & 0xFF;
+    }
+}
+
+//------------------------------------------------------------------------------
+static void unpack12 (const unsigned char *p, unsigned short *code)
+{
+    int i;
+
+    for (i = 0; i < LOG_CH_CNT; i += 2, p += 3) {
+        code[i]     = p[0] | ((p[1] & 0x0F) << 8);
+        code[i + 1] = (p[1] >> 4) | (p[2] << 4);
+    }
+}
+
+//------------------------------------------------------------------------------
+// 모든 channel의 차이(d)를 저장할 수 있는 frame type
+//------------------------------------------------------------------------------
+static int delta_type (const int *d, int delta)
+{
+    int i, max = 0;
+
+    if (!delta)
+        return LOG_FULL;
+
+    for (i = 0; i < LOG_CH_CNT; i++) {
+        if ((d[i] < -128) || (d[i] > 127))
+            return LOG_FULL;
+        if ((d[i] < -8) || (d[i] > 7))
+            max = 1;
+    }
+    return max ? LOG_DELTA8 : LOG_DELTA4;
+}
+
+//------------------------------------------------------------------------------
+static int write_all (int fd, const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+    ssize_t ret;
+
+    while (len) {
+        if ((ret = write(fd, p, len)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p   += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// 기록중인 block을 file에 씀. (남은 영역은 0)
+//------------------------------------------------------------------------------
+static int block_flush (struct adc_log *l)
+{
+    int ret;
+
+    if (!l->blk.frames)
+        return 0;
+
+    memcpy(l->buf, &l->blk, sizeof(struct log_blk));
+    memset(l->buf + l->blk.used, 0, LOG_BLOCK - l->blk.used);
+    ret = write_all (l->fd, l->buf, LOG_BLOCK);
+
+    l->blk.frames = 0;
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+// reader : block header (정렬되지 않은 file data이므로 copy). return NULL : 잘못된 block
+//------------------------------------------------------------------------------
+static const struct log_blk *block_get (const struct adc_log *l, unsigned int blk, struct log_blk *bh)
+{
+    if (blk >= l->blocks)
+        return NULL;
+
+    memcpy(bh, l->map + LOG_BLOCK * (blk + 1), sizeof(struct log_blk));
+    if (!bh->frames || (bh->used > LOG_BLOCK) ||
+        (bh->used < sizeof(struct log_blk) + LOG_FRAME_HDR + LOG_PACK_SIZE))
+        return NULL;
+    return bh;
+}
+
+//------------------------------------------------------------------------------
+// pos의 다음 frame을 decoding 함. 잘못된 block은 건너뜀. return 1 : success, 0 : end
+//------------------------------------------------------------------------------
+static int frame_next (const struct adc_log *l, struct log_pos *pos)
+{
+    const unsigned char *p;
+    unsigned long long mask;
+    struct log_blk bh;
+    unsigned int off;
+    uint32_t dt;
+    int i, d, tag;
+
+    while (pos->blk < l->blocks) {
+        if ((block_get (l, pos->blk, &bh) == NULL) || (pos->idx >= bh.frames)) {
+            pos->blk++;
+            pos->idx = 0;
+            continue;
+        }
+        p = l->map + LOG_BLOCK * (pos->blk + 1);
+
+        if (!pos->idx) {
+            pos->ts  = bh.ts0;
+            pos->off = sizeof(struct log_blk);
+        }
+        off = pos->off;
+        if (off + LOG_FRAME_HDR > bh.used)
+            goto bad_block;
+
+        tag = p[off];
+        memcpy(&dt, p + off + 1, sizeof(dt));
+        off += LOG_FRAME_HDR;
+
+        // keyframe은 항상 LOG_FULL
+        if (!pos->idx && ((tag & ~LOG_FLAGS) != LOG_FULL))
+            goto bad_block;
+
+        memset(pos->flags, 0, sizeof(pos->flags));
+        if (tag & LOG_FLAGS) {
+            if (off + sizeof(mask) > bh.used)
+                goto bad_block;
+            memcpy(&mask, p + off, sizeof(mask));
+            off += sizeof(mask);
+            if (off + __builtin_popcountll(mask) > bh.used)
+                goto bad_block;
+            for (i = 0; i < LOG_CH_CNT; i++)
+                if (mask & (1ULL << i))
+                    pos->flags[i] = p[off++];
+        }
+
+        switch (tag & ~LOG_FLAGS) {
+        case LOG_FULL:
+            if (off + LOG_PACK_SIZE > bh.used)
+                goto bad_block;
+            unpack12 (p + off, pos->code);
+            off += LOG_PACK_SIZE;
+            break;
+        case LOG_DELTA8:
+            if (off + LOG_CH_CNT > bh.used)
+                goto bad_block;
+            for (i = 0; i < LOG_CH_CNT; i++)
+                pos->code[i] = (pos->code[i] + (signed char)p[off + i]) & 0xFFF;
+            off += LOG_CH_CNT;
+            break;
+        case LOG_DELTA4:
+            if (off + LOG_CH_CNT / 2 > bh.used)
+                goto bad_block;
+            for (i = 0; i < LOG_CH_CNT; i++) {
+                d = (p[off + i / 2] >> ((i & 1) * 4)) & 0x0F;
+                d = (d ^ 0x08) - 0x08;
+                pos->code[i] = (pos->code[i] + d) & 0xFFF;
+            }
+            off += LOG_CH_CNT / 2;
+            break;
+        default:
+            goto bad_block;
+        }
+        pos->off = off;
+        pos->ts += dt;
+        pos->idx++;
+        return 1;
+bad_block:
+        pos->blk++;
+        pos->idx = 0;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// decoding된 frame -> snapshot (bipolar channel sign-extend, calibration 적용)
+//------------------------------------------------------------------------------
+static void frame_out (const struct adc_log *l, const struct log_pos *pos, struct adc_snapshot *snap)
+{
+    unsigned short *raw = &snap->raw[0][0];
+    struct log_blk bh;
+    int i;
+
+    snap->ts_ns = pos->ts;
+    snap->seq   = block_get (l, pos->blk, &bh) ? bh.frame0 + pos->idx : 0;
+    memcpy(snap->flags, pos->flags, sizeof(snap->flags));
+
+    for (i = 0; i < LOG_CH_CNT; i++)
+        raw[i] = (l->hdr.mode[i] & ADC_MODE_BIPOLAR) ? RAW_SEXT12(pos->code[i]) : pos->code[i];
+
+    cal_convert (&l->cal, raw, &snap->mv[0][0], LOG_CH_CNT);
+}
+
+//------------------------------------------------------------------------------
+// capture log file 생성. board의 pin map, input mode, calibration을 header에 기록함.
+// flags : ADC_LOG_DELTA (delta frame 사용). return NULL : error
+//------------------------------------------------------------------------------
+struct adc_log *adc_log_create (adc_board_t *b, const char *fname, int flags)
+{
+    struct adc_log *l;
+    struct timespec ts;
+    const char *name;
+    int i;
+
+    if ((b == NULL) || (fname == NULL))
+        return NULL;
+
+    if ((l = calloc(1, sizeof(struct adc_log))) == NULL)
+        return NULL;
+
+    if ((l->fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+        fprintf(stderr, "%s : %s open error : %s\n", __func__, fname, strerror(errno));
+        free (l);
+        return NULL;
+    }
+
+    memcpy(l->hdr.magic, LOG_MAGIC, sizeof(l->hdr.magic));
+    l->hdr.version    = LOG_VERSION;
+    l->hdr.block_size = LOG_BLOCK;
+    l->hdr.ch_cnt     = LOG_CH_CNT;
+    l->hdr.flags      = flags;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    l->hdr.start_ns      = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    l->hdr.start_real_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    pthread_mutex_lock(&b->lock);
+    for (i = 0; i < LOG_CH_CNT; i++) {
+        l->hdr.mode[i]   = b->mode[i];
+        l->hdr.gain[i]   = b->cal.gain[i];
+        l->hdr.offset[i] = b->cal.offset[i];
+    }
+    pthread_mutex_unlock(&b->lock);
+
+    for (i = 0; i < LOG_CH_CNT; i++)
+        if ((name = adc_pin_name (i)) != NULL)
+            strncpy(l->hdr.name[i], name, LOG_NAME_LEN - 1);
+
+    // header block
+    memset(l->buf, 0, LOG_BLOCK);
+    memcpy(l->buf, &l->hdr, sizeof(struct log_hdr));
+    if (write_all (l->fd, l->buf, LOG_BLOCK)) {
+        fprintf(stderr, "%s : %s write error : %s\n", __func__, fname, strerror(errno));
+        close (l->fd);
+        free (l);
+        return NULL;
+    }
+    l->writer = 1;
+    return l;
+}
+
+//------------------------------------------------------------------------------
+// snapshot 1개를 기록함. (snap->ts_ns는 증가해야 함) return 0 : success, -1 : write error
+//------------------------------------------------------------------------------
+int adc_log_append (struct adc_log *l, const struct adc_snapshot *snap)
+{
+    const unsigned short *raw;
+    const unsigned char *flags;
+    unsigned short code [LOG_CH_CNT];
+    int d [LOG_CH_CNT], i, type, size, ext;
+    unsigned long long mask = 0;
+    unsigned char *p;
+    uint32_t dt;
+
+    if ((l == NULL) || !l->writer || (snap == NULL))
+        return -1;
+
+    raw   = &snap->raw[0][0];
+    flags = &snap->flags[0][0];
+    for (i = 0; i < LOG_CH_CNT; i++) {
+        code[i] = raw[i] & 0xFFF;
+        d[i]    = ((code[i] - l->code[i] + 2048) & 0xFFF) - 2048;
+        mask   |= flags[i] ? (1ULL << i) : 0;
+    }
+    ext = mask ? sizeof(mask) + __builtin_popcountll(mask) : 0;
+
+    type = delta_type (d, l->hdr.flags & ADC_LOG_DELTA);
+    size = LOG_FRAME_HDR + ext + ((type == LOG_FULL)   ? LOG_PACK_SIZE :
+                                  (type == LOG_DELTA8) ? LOG_CH_CNT : LOG_CH_CNT / 2);
+
+    // block이 가득 찼거나 dt가 범위를 벗어나면 새 block (keyframe)
+    if (l->blk.frames && ((snap->ts_ns < l->ts) || (snap->ts_ns - l->ts > UINT32_MAX) ||
+                          (l->blk.used + size > LOG_BLOCK))) {
+        if (block_flush (l))
+            return -1;
+    }
+
+    if (!l->blk.frames) {
+        type = LOG_FULL;
+        dt   = 0;
+        l->blk.ts0    = snap->ts_ns;
+        l->blk.frame0 = l->frames;
+        l->blk.used   = sizeof(struct log_blk);
+    } else {
+        dt   = snap->ts_ns - l->ts;
+    }
+
+    p    = l->buf + l->blk.used;
+    p[0] = type | (mask ? LOG_FLAGS : 0);
+    memcpy(p + 1, &dt, sizeof(dt));
+    p += LOG_FRAME_HDR;
+
+    if (mask) {
+        memcpy(p, &mask, sizeof(mask));
+        p += sizeof(mask);
+        for (i = 0; i < LOG_CH_CNT; i++)
+            if (flags[i])
+                *p++ = flags[i];
+    }
+
+    switch (type) {
+    case LOG_FULL:
+        pack12 (code, p);
+        p += LOG_PACK_SIZE;
+        break;
+    case LOG_DELTA8:
+        for (i = 0; i < LOG_CH_CNT; i++)
+            *p++ = (unsigned char)d[i];
+        break;
+    case LOG_DELTA4:
+        for (i = 0; i < LOG_CH_CNT; i += 2)
+            *p++ = (d[i] & 0x0F) | ((d[i + 1] & 0x0F) << 4);
+        break;
+    }
+    l->blk.frames++;
+    l->blk.used = p - l->buf;
+
+    memcpy(l->code, code, sizeof(code));
+    l->ts = snap->ts_ns;
+    l->frames++;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// capture log file을 replay용으로 map 함. return NULL : 없음 또는 다른 format
+//------------------------------------------------------------------------------
+struct adc_log *adc_log_open (const char *fname)
+{
+    struct adc_log *l;
+    struct stat st;
+    int fd, i;
+
+    if ((fname == NULL) || ((fd = open(fname, O_RDONLY)) < 0))
+        return NULL;
+
+    if (fstat(fd, &st) || (st.st_size < LOG_BLOCK)) {
+        close (fd);
+        return NULL;
+    }
+
+    if ((l = calloc(1, sizeof(struct adc_log))) == NULL) {
+        close (fd);
+        return NULL;
+    }
+
+    l->map_size = st.st_size;
+    l->map      = mmap(NULL, l->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+
+    if (l->map == MAP_FAILED) {
+        free (l);
+        return NULL;
+    }
+    memcpy(&l->hdr, l->map, sizeof(struct log_hdr));
+
+    if (memcmp(l->hdr.magic, LOG_MAGIC, sizeof(l->hdr.magic)) ||
+        (l->hdr.version != LOG_VERSION) || (l->hdr.block_size != LOG_BLOCK) ||
+        (l->hdr.ch_cnt != LOG_CH_CNT)) {
+        fprintf(stderr, "%s : %s is not adc capture log\n", __func__, fname);
+        munmap ((void *)l->map, l->map_size);
+        free (l);
+        return NULL;
+    }
+
+    for (i = 0; i < LOG_CH_CNT; i++) {
+        // 잘못된 calibration은 변환시 overflow 되므로 file을 사용하지 않음
+        if (!cal_valid (l->hdr.gain[i], l->hdr.offset[i])) {
+            fprintf(stderr, "%s : %s wrong calibration (ch %d)\n", __func__, fname, i);
+            munmap ((void *)l->map, l->map_size);
+            free (l);
+            return NULL;
+        }
+        l->cal.gain[i]   = l->hdr.gain[i];
+        l->cal.offset[i] = l->hdr.offset[i];
+        l->hdr.name[i][LOG_NAME_LEN - 1] = 0;
+    }
+    // 마지막 불완전 block은 사용하지 않음
+    l->blocks = l->map_size / LOG_BLOCK - 1;
+    l->fd     = -1;
+    return l;
+}
+
+//------------------------------------------------------------------------------
+// writer : 기록중인 block을 쓰고 닫음. reader : unmap. return 0 : success, -1 : write error
+//------------------------------------------------------------------------------
+int adc_log_close (struct adc_log *l)
+{
+    int ret = 0;
+
+    if (l == NULL)
+        return -1;
+
+    if (l->writer) {
+        ret = block_flush (l);
+        if (close (l->fd))
+            ret = -1;
+    }
+    else
+        munmap ((void *)l->map, l->map_size);
+
+    free (l);
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+// reader : 처음/마지막 frame의 시간. return 0 : success, -1 : frame 없음
+//------------------------------------------------------------------------------
+int adc_log_range (struct adc_log *l, unsigned long long *first_ns, unsigned long long *last_ns)
+{
+    struct log_pos pos;
+    int blk;
+
+    if ((l == NULL) || l->writer)
+        return -1;
+
+    memset(&pos, 0, sizeof(pos));
+    if (!frame_next (l, &pos))
+        return -1;
+    if (first_ns)
+        *first_ns = pos.ts;
+
+    // 마지막 유효 block만 decoding
+    for (blk = l->blocks - 1; blk >= 0; blk--) {
+        memset(&pos, 0, sizeof(pos));
+        pos.blk = blk;
+        if (frame_next (l, &pos) && (pos.blk == (unsigned int)blk))
+            break;
+    }
+    while (frame_next (l, &pos))
+        ;
+    if (last_ns)
+        *last_ns = pos.ts;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// reader : ts_ns 이후의 첫 frame으로 이동 (block binary search + block 안 decoding)
+// return 1 : success, 0 : ts_ns 이후 frame 없음, -1 : error
+//------------------------------------------------------------------------------
+int adc_log_seek (struct adc_log *l, unsigned long long ts_ns)
+{
+    struct log_pos pos, prev;
+    struct log_blk bh;
+    unsigned int lo, hi, mid;
+
+    if ((l == NULL) || l->writer)
+        return -1;
+
+    // ts0 <= ts_ns 인 마지막 block (잘못된 block은 앞쪽 block 기준)
+    lo = 0, hi = l->blocks;
+    while (hi - lo > 1) {
+        mid = (lo + hi) / 2;
+        if (block_get (l, mid, &bh) && (bh.ts0 > ts_ns))
+            hi = mid;
+        else
+            lo = mid;
+    }
+
+    memset(&pos, 0, sizeof(pos));
+    pos.blk = lo;
+    for (prev = pos; frame_next (l, &pos); prev = pos) {
+        if (pos.ts >= ts_ns) {
+            l->pos = prev;
+            return 1;
+        }
+    }
+    l->pos = pos;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// reader : 다음 frame을 snap에 저장함. snap->seq = frame 번호 (1 ~)
+// return 1 : success, 0 : end of log, -1 : error
+//------------------------------------------------------------------------------
+int adc_log_next (struct adc_log *l, struct adc_snapshot *snap)
+{
+    if ((l == NULL) || l->writer || (snap == NULL))
+        return -1;
+
+    if (!frame_next (l, &l->pos))
+        return 0;
+
+    frame_out (l, &l->pos, snap);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+// 기록시의 pin map. return NULL : header에 연결되지 않은 chip/channel
+//------------------------------------------------------------------------------
+const char *adc_log_pin_name (struct adc_log *l, adc_pin_t pin)
+{
+    if ((l == NULL) || (pin >= LOG_CH_CNT) || !l->hdr.name[pin][0])
+        return NULL;
+
+    return l->hdr.name[pin];
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
@@ -0,0 +1,373 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_mock.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) simulated I2C backend for ODROID-JIG.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "lib_i2cadc.h"
+#include "lib_i2cadc_priv.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Mock backend. 6개의 LTC2309가 연결된 I2C bus를 흉내냄. (H/W 없이 test/benchmark)
+//
+//  - chip은 STOP에서 마지막으로 받은 command로 conversion을 진행하고, read시 이전
+//    conversion 결과를 돌려줌. command 없이 read만 하면 이전 command를 유지함.
+//  - I2C_RDWR는 전체 message 후 1회의 STOP으로 처리하며, funcs에
+//    I2C_FUNC_PROTOCOL_MANGLING이 있으면 I2C_M_STOP이 설정된 message에서도 STOP 처리.
+//  - 없는 chip(cfg.present)을 addressing 하면 NAK (transaction 전체 실패)
+//  - transaction마다 call_us + (address + data byte) x 9 bit / bus_khz의 시간을 소비함.
+//  - 입력 전압은 cfg.input_mv(chip, ch) (COM 기준 mV), REF = 5000 mV
+//  - cfg.fault(chip)로 chip transaction의 NAK, SDA stuck(recover 전까지 모든 transaction
+//    실패)을 만들 수 있음.
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+#define MOCK_REF_MV     5000
+
+struct mock_chip {
+    unsigned char       cmd;            // 마지막 command (DIN)
+    unsigned short      result;         // 마지막 conversion 결과 (12 bits)
+    int                 addressed;      // STOP 전 addressing 여부 (I2C_RDWR)
+};
+
+struct mock_bus {
+    struct adc_mock_cfg cfg;
+    struct mock_chip    chip [ADC_CHIP_CNT];
+    unsigned char       chip_addr [ADC_CHIP_CNT];   // board description의 chip address
+    int                 addr;           // I2C_SLAVE address
+    int                 stuck;          // SDA stuck (recover 전까지 bus 사용 불가)
+    unsigned long long  calls;          // backend 호출(syscall) 수
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  void    mock_delay              (struct mock_bus *m, int bytes);
+static  int     mock_chip_idx           (struct mock_bus *m, int addr);
+static  int     mock_fault              (struct mock_bus *m, int chip);
+static  int     mock_input              (struct mock_bus *m, int chip, int ch);
+static  void    mock_convert            (struct mock_bus *m, int chip);
+static  void    mock_stop               (struct mock_bus *m);
+static  int     mock_set_addr           (void *ctx, unsigned char addr);
+static  int     mock_read_word          (void *ctx, unsigned char cmd);
+static  int     mock_rdwr               (void *ctx, struct i2c_msg *msg, int nmsgs);
+static  int     mock_read               (void *ctx, unsigned char *buf, int len);
+static  int     mock_write              (void *ctx, const unsigned char *buf, int len);
+static  unsigned long mock_funcs        (void *ctx);
+static  void    mock_close              (void *ctx);
+static  int     mock_recover            (void *ctx);
+
+        adc_board_t *adc_board_open_mock (const struct adc_mock_cfg *cfg);
+        int     adc_mock_value          (int chip, int ch);
+        unsigned long long adc_mock_calls (adc_board_t *b);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static const struct adc_bus_ops MockBus = {
+    "mock",
+    mock_set_addr,
+    mock_read_word,
+    mock_rdwr,
+    mock_read,
+    mock_write,
+    mock_funcs,
+    mock_close,
+    mock_recover,
+};
+
+//------------------------------------------------------------------------------
+// bus 전송 시간 (busy wait, usleep은 정밀도가 부족함)
+//------------------------------------------------------------------------------
+static void mock_delay (struct mock_bus *m, int bytes)
+{
+    unsigned long long ns = m->cfg.call_us * 1000ULL, end;
+    struct timespec ts;
+
+    if (m->cfg.bus_khz > 0)
+        ns += bytes * 9 * 1000000ULL / m->cfg.bus_khz;
+    if (!ns)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    end = ts.tv_sec * 1000000000ULL + ts.tv_nsec + ns;
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+    } while ((ts.tv_sec * 1000000000ULL + ts.tv_nsec) < end);
+}
+
+//------------------------------------------------------------------------------
+// address의 chip index. return -1 : 없는 chip (NAK)
+//------------------------------------------------------------------------------
+static int mock_chip_idx (struct mock_bus *m, int addr)
+{
+    int i;
+
+    for (i = 0; i < ADC_CHIP_CNT; i++)
+        if (m->chip_addr[i] == addr)
+            return (m->cfg.present & (1 << i)) ? i : -1;
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+// chip transaction의 fault. return 1 : transaction 실패
+//------------------------------------------------------------------------------
+static int mock_fault (struct mock_bus *m, int chip)
+{
+    int f;
+
+    if (m->stuck)
+        return 1;
+    if (!m->cfg.fault || ((f = m->cfg.fault (chip, m->cfg.arg)) == ADC_MOCK_OK))
+        return 0;
+
+    m->stuck = (f == ADC_MOCK_STUCK);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+static int mock_input (struct mock_bus *m, int chip, int ch)
+{
+    return m->cfg.input_mv ? m->cfg.input_mv (chip, ch, m->cfg.arg) : adc_mock_value (chip, ch);
+}
+
+//------------------------------------------------------------------------------
+// chip의 현재 command로 conversion. (S/D, O/S, S1, S0, UNI)
+//------------------------------------------------------------------------------
+static void mock_convert (struct mock_bus *m, int chip)
+{
+    unsigned char cmd = m->chip[chip].cmd;
+    int ch = ((cmd >> 4) & 3) * 2 + ((cmd & ADC_CMD_OS) ? 1 : 0);
+    int mv = mock_input (m, chip, ch), code;
+
+    if (!(cmd & ADC_CMD_SD))
+        mv -= mock_input (m, chip, ch ^ 1);
+
+    code = mv * 4096 / MOCK_REF_MV;
+    if (cmd & ADC_CMD_UNI)
+        code = (code < 0) ? 0 : (code > 4095) ? 4095 : code;
+    else
+        code = (code < -2048) ? -2048 : (code > 2047) ? 2047 : code;
+
+    m->chip[chip].result = code & 0xFFF;
+}
+
+//------------------------------------------------------------------------------
+// STOP condition : addressing된 모든 chip이 conversion을 시작 (결과는 바로 반영)
+//------------------------------------------------------------------------------
+static void mock_stop (struct mock_bus *m)
+{
+    int i;
+
+    for (i = 0; i < ADC_CHIP_CNT; i++) {
+        if (!m->chip[i].addressed)
+            continue;
+        m->chip[i].addressed = 0;
+        mock_convert (m, i);
+    }
+}
+
+//------------------------------------------------------------------------------
+static int mock_set_addr (void *ctx, unsigned char addr)
+{
+    struct mock_bus *m = (struct mock_bus *)ctx;
+
+    m->calls++;
+    m->addr = addr;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// SMBus read word : command write + repeated START + 2 byte read + STOP
+//------------------------------------------------------------------------------
+static int mock_read_word (void *ctx, unsigned char cmd)
+{
+    struct mock_bus *m = (struct mock_bus *)ctx;
+    int c = mock_chip_idx (m, m->addr), w;
+
+    m->calls++;
+    if ((c < 0) || mock_fault (m, c)) {
+        mock_delay (m, 1);
+        return -1;
+    }
+    mock_delay (m, 5);
+
+    w = m->chip[c].result << 4;
+    m->chip[c].cmd = cmd;
+    mock_convert (m, c);
+
+    // i2c_read_word 형식 (첫 byte = LSB)
+    return ((w >> 8) & 0xFF) | ((w & 0xFF) << 8);
+}
+
+//------------------------------------------------------------------------------
+static int mock_rdwr (void *ctx, struct i2c_msg *msg, int nmsgs)
+{
+    struct mock_bus *m = (struct mock_bus *)ctx;
+    int i, c, w, bytes = 0;
+
+    m->calls++;
+    if (!(m->cfg.funcs & I2C_FUNC_I2C) || (nmsgs > I2C_RDWR_IOCTL_MAX_MSGS))
+        return -1;
+
+    for (i = 0; i < nmsgs; i++) {
+        bytes += msg[i].len + 1;
+        if (((c = mock_chip_idx (m, msg[i].addr)) < 0) || mock_fault (m, c)) {
+            mock_delay (m, bytes);
+            return -1;
+        }
+    }
+    mock_delay (m, bytes);
+
+    for (i = 0; i < nmsgs; i++) {
+        c = mock_chip_idx (m, msg[i].addr);
+        m->chip[c].addressed = 1;
+
+        if (!(msg[i].flags & I2C_M_RD)) {
+            if (msg[i].len)
+                m->chip[c].cmd = msg[i].buf[0];
+            continue;
+        }
+        w = m->chip[c].result << 4;
+        if (msg[i].len > 0) msg[i].buf[0] = (w >> 8) & 0xFF;
+        if (msg[i].len > 1) msg[i].buf[1] = w & 0xFF;
+
+        if ((msg[i].flags & I2C_M_STOP) && (m->cfg.funcs & I2C_FUNC_PROTOCOL_MANGLING))
+            mock_stop (m);
+    }
+    mock_stop (m);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// plain read : 이전 결과 read, 같은 command로 다음 conversion
+//------------------------------------------------------------------------------
+static int mock_read (void *ctx, unsigned char *buf, int len)
+{
+    struct mock_bus *m = (struct mock_bus *)ctx;
+    int c = mock_chip_idx (m, m->addr), w;
+
+    m->calls++;
+    mock_delay (m, len + 1);
+    if ((c < 0) || (len != 2) || mock_fault (m, c))
+        return -1;
+
+    w = m->chip[c].result << 4;
+    buf[0] = (w >> 8) & 0xFF;
+    buf[1] = w & 0xFF;
+    mock_convert (m, c);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static int mock_write (void *ctx, const unsigned char *buf, int len)
+{
+    struct mock_bus *m = (struct mock_bus *)ctx;
+    int c = mock_chip_idx (m, m->addr);
+
+    m->calls++;
+    mock_delay (m, len + 1);
+    if ((c < 0) || (len != 1) || mock_fault (m, c))
+        return -1;
+
+    m->chip[c].cmd = buf[0];
+    mock_convert (m, c);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static unsigned long mock_funcs (void *ctx)
+{
+    struct mock_bus *m = (struct mock_bus *)ctx;
+
+    m->calls++;
+    return m->cfg.funcs;
+}
+
+//------------------------------------------------------------------------------
+static void mock_close (void *ctx)
+{
+    free (ctx);
+}
+
+//------------------------------------------------------------------------------
+// bus recovery (clock-out) : SDA stuck 해제, I2C_SLAVE 설정은 초기화됨
+//------------------------------------------------------------------------------
+static int mock_recover (void *ctx)
+{
+    struct mock_bus *m = (struct mock_bus *)ctx;
+
+    m->calls++;
+    m->stuck = 0;
+    m->addr  = -1;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// mock board 생성. (cfg == NULL : 모든 chip, SMBus만, 지연 없음) return NULL : fail
+//------------------------------------------------------------------------------
+adc_board_t *adc_board_open_mock (const struct adc_mock_cfg *cfg)
+{
+    struct mock_bus *m;
+    adc_board_t *b;
+    int i;
+
+    if ((m = calloc(1, sizeof(struct mock_bus))) == NULL)
+        return NULL;
+
+    if (cfg)
+        m->cfg = *cfg;
+    // 현재 board description(adc_desc_load)의 chip 구성을 simulation
+    i = (1 << desc_chips (m->chip_addr)) - 1;
+    m->cfg.present = m->cfg.present ? (m->cfg.present & i) : i;
+
+    m->addr = -1;
+    for (i = 0; i < ADC_CHIP_CNT; i++) {
+        m->chip[i].cmd = ADC_CH_ADDR[0];
+        mock_convert (m, i);
+    }
+
+    if ((b = adc_board_open_bus (&MockBus, m)) == NULL)
+        free (m);
+    return b;
+}
+
+//------------------------------------------------------------------------------
+// 기본 입력 전압(mV). chip/channel마다 다른 값 (100 ~ 4730 mV)
+//------------------------------------------------------------------------------
+int adc_mock_value (int chip, int ch)
+{
+    return 100 + chip * 800 + ch * 90;
+}
+
+//------------------------------------------------------------------------------
+// mock backend 호출(= 실제 H/W의 syscall) 수. return 0 : mock board가 아님
+//------------------------------------------------------------------------------
+unsigned long long adc_mock_calls (adc_board_t *b)
+{
+    if ((b == NULL) || (b->ops != &MockBus))
+        return 0;
+
+    return ((struct mock_bus *)b->bus_ctx)->calls;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
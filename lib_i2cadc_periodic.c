@@ -0,0 +1,255 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_periodic.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) deterministic periodic scan for ODROID-JIG.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "lib_i2cadc.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Periodic scan. 지정된 pin을 정확한 주기(deadline = 시작 시간 + n * period)로 읽음.
+//
+//  - clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME)으로 다음 deadline까지 기다리므로
+//    scan 시간의 변화가 주기에 누적되지 않음.
+//  - scan이 다음 deadline을 넘긴 경우 놓친 주기는 건너뛰고(missed) 원래의 주기 grid를
+//    유지함. (현재 시간 기준으로 다시 시작하지 않음)
+//  - jitter = scan 시작(wakeup) 시간 - deadline
+//  - 필요시 SCHED_FIFO priority, CPU affinity를 설정한 thread에서 동작함. (root 권한 필요)
+//
+// scan 결과(mV, flags)는 scan마다 thread에서 cfg.scan(ts_ns, mv, flags, n, arg)으로 전달되며
+// callback 시간도 scan 시간에 포함되므로 callback은 짧게 처리해야 함.
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+#define PERIODIC_PIN_MAX    (ADC_CHIP_CNT * ADC_CH_CNT)
+
+struct adc_periodic {
+    adc_board_t         *board;
+    struct adc_periodic_cfg cfg;
+    adc_pin_t           pins [PERIODIC_PIN_MAX];
+    int                 mv   [PERIODIC_PIN_MAX];
+    unsigned char       flags[PERIODIC_PIN_MAX];
+    pthread_t           thread;
+    atomic_int          run;
+
+    // timing 통계 (RT thread에서 사용하므로 priority inheritance lock)
+    pthread_mutex_t     stat_lock;
+    struct adc_timing   timing;
+    long long           jitter_sum;
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  unsigned long long  ts_to_ns    (const struct timespec *t);
+static  void    ns_to_ts                (unsigned long long ns, struct timespec *t);
+static  void    timing_update           (struct adc_periodic *p, long long jitter,
+                                         unsigned long long scan_ns, unsigned long long missed);
+static  void    *periodic_thread        (void *arg);
+static  int     thread_attr_setup       (pthread_attr_t *attr, const struct adc_periodic_cfg *cfg);
+
+        struct adc_periodic *adc_periodic_start (adc_board_t *b, const struct adc_periodic_cfg *cfg);
+        void    adc_periodic_stop       (struct adc_periodic *p);
+        int     adc_periodic_timing     (struct adc_periodic *p, struct adc_timing *t, int reset);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static unsigned long long ts_to_ns (const struct timespec *t)
+{
+    return (unsigned long long)t->tv_sec * 1000000000ULL + t->tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+static void ns_to_ts (unsigned long long ns, struct timespec *t)
+{
+    t->tv_sec  = ns / 1000000000ULL;
+    t->tv_nsec = ns % 1000000000ULL;
+}
+
+//------------------------------------------------------------------------------
+static void timing_update (struct adc_periodic *p, long long jitter,
+                           unsigned long long scan_ns, unsigned long long missed)
+{
+    struct adc_timing *t = &p->timing;
+
+    pthread_mutex_lock(&p->stat_lock);
+    if (!t->scans || (jitter < t->jitter_min_ns))
+        t->jitter_min_ns = jitter;
+    if (!t->scans || (jitter > t->jitter_max_ns))
+        t->jitter_max_ns = jitter;
+
+    t->scans++;
+    t->missed        += missed;
+    t->scan_max_ns    = (scan_ns > t->scan_max_ns) ? scan_ns : t->scan_max_ns;
+    p->jitter_sum    += jitter;
+    t->jitter_avg_ns  = p->jitter_sum / (long long)t->scans;
+    pthread_mutex_unlock(&p->stat_lock);
+}
+
+//------------------------------------------------------------------------------
+static void *periodic_thread (void *arg)
+{
+    struct adc_periodic *p = (struct adc_periodic *)arg;
+    unsigned long long period = p->cfg.period_us * 1000ULL;
+    unsigned long long deadline, start, end, missed;
+    struct timespec ts;
+    long long jitter;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    deadline = ts_to_ns (&ts) + period;
+
+    while (atomic_load_explicit(&p->run, memory_order_relaxed)) {
+        ns_to_ts (deadline, &ts);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        start = ts_to_ns (&ts);
+
+        adc_board_read_flags (p->board, p->pins, p->cfg.n, p->mv, p->flags);
+        if (p->cfg.scan)
+            p->cfg.scan (start, p->mv, p->flags, p->cfg.n, p->cfg.arg);
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        end    = ts_to_ns (&ts);
+        jitter = (long long)(start - deadline);
+
+        // 다음 deadline을 이미 지난 경우 놓친 주기를 건너뜀
+        deadline += period;
+        missed    = (end > deadline) ? (end - deadline) / period + 1 : 0;
+        deadline += missed * period;
+
+        timing_update (p, jitter, end - start, missed);
+    }
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+// cfg의 priority/cpu로 thread attribute 설정. return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+static int thread_attr_setup (pthread_attr_t *attr, const struct adc_periodic_cfg *cfg)
+{
+    struct sched_param param;
+    cpu_set_t cpus;
+
+    if (cfg->priority > 0) {
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = cfg->priority;
+        if (pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED) ||
+            pthread_attr_setschedpolicy(attr, SCHED_FIFO) ||
+            pthread_attr_setschedparam(attr, &param))
+            return -1;
+    }
+    if (cfg->cpu >= 0) {
+        CPU_ZERO(&cpus);
+        CPU_SET(cfg->cpu, &cpus);
+        if (pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus))
+            return -1;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// cfg.pins[cfg.n]을 cfg.period_us 주기로 읽는 thread를 시작함.
+// cfg.priority > 0 이면 SCHED_FIFO, cfg.cpu >= 0 이면 해당 CPU에서만 동작함.
+// return NULL : 잘못된 설정 또는 thread 생성 실패 (SCHED_FIFO 권한 없음 등)
+//------------------------------------------------------------------------------
+struct adc_periodic *adc_periodic_start (adc_board_t *b, const struct adc_periodic_cfg *cfg)
+{
+    struct adc_periodic *p;
+    pthread_mutexattr_t mattr;
+    pthread_attr_t attr;
+    int ret;
+
+    if ((b == NULL) || (cfg == NULL) || (cfg->pins == NULL) || (cfg->period_us <= 0))
+        return NULL;
+    if ((cfg->n <= 0) || (cfg->n > PERIODIC_PIN_MAX))
+        return NULL;
+    if ((cfg->priority < 0) || (cfg->priority > sched_get_priority_max(SCHED_FIFO)))
+        return NULL;
+    if (cfg->cpu >= CPU_SETSIZE)
+        return NULL;
+
+    if ((p = calloc(1, sizeof(struct adc_periodic))) == NULL)
+        return NULL;
+
+    p->board = b;
+    p->cfg   = *cfg;
+    memcpy(p->pins, cfg->pins, sizeof(adc_pin_t) * cfg->n);
+    atomic_init(&p->run, 1);
+
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&p->stat_lock, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+
+    pthread_attr_init(&attr);
+    if ((ret = thread_attr_setup (&attr, cfg)) == 0)
+        ret = pthread_create(&p->thread, &attr, periodic_thread, p);
+    pthread_attr_destroy(&attr);
+
+    if (ret) {
+        fprintf(stderr, "%s : thread create error (priority = %d, cpu = %d) : %s\n",
+            __func__, cfg->priority, cfg->cpu, strerror(ret > 0 ? ret : EINVAL));
+        pthread_mutex_destroy(&p->stat_lock);
+        free (p);
+        return NULL;
+    }
+    return p;
+}
+
+//------------------------------------------------------------------------------
+void adc_periodic_stop (struct adc_periodic *p)
+{
+    if (p == NULL)
+        return;
+
+    atomic_store(&p->run, 0);
+    pthread_join(p->thread, NULL);
+    pthread_mutex_destroy(&p->stat_lock);
+    free (p);
+}
+
+//------------------------------------------------------------------------------
+// timing 통계를 t에 복사함. reset != 0 이면 복사 후 초기화.
+// return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+int adc_periodic_timing (struct adc_periodic *p, struct adc_timing *t, int reset)
+{
+    if ((p == NULL) || (t == NULL))
+        return -1;
+
+    pthread_mutex_lock(&p->stat_lock);
+    *t = p->timing;
+    if (reset) {
+        memset(&p->timing, 0, sizeof(struct adc_timing));
+        p->jitter_sum = 0;
+    }
+    pthread_mutex_unlock(&p->stat_lock);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
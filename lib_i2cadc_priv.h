@@ -0,0 +1,179 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_priv.h
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) control library internal interface.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#ifndef __LIB_I2CADC_PRIV_H__
+#define __LIB_I2CADC_PRIV_H__
+
+#include <pthread.h>
+
+//------------------------------------------------------------------------------
+// lib_i2cadc.c 내부 table/function (library 내부 module에서만 사용)
+//------------------------------------------------------------------------------
+// LTC2309 I2C address(기본 board description), channel command (single-ended, unipolar)
+extern const unsigned char ADC_I2C_ADDR[];
+extern const unsigned char ADC_CH_ADDR[];
+
+// LTC2309 command(DIN) bit : S/D, O/S, S1, S0, UNI, SLP, x, x
+#define ADC_CMD_SD      0x80
+#define ADC_CMD_OS      0x40
+#define ADC_CMD_UNI     0x08
+#define ADC_CMD_SLP     0x04
+
+// chip/channel(adc_pin_t)의 현재 command
+#define CH_CMD(b, adc, ch)  ((b)->cmd [(adc) * ADC_CH_CNT + (ch)])
+// bipolar channel의 12 bits 2의 보수를 int16으로 sign-extend
+#define RAW_SEXT12(raw)     ((unsigned short)((short)((raw) << 4) >> 4))
+
+//------------------------------------------------------------------------------
+// Calibration table (chip/channel 순서, Q16). mV = (raw * gain + offset) >> 16
+//------------------------------------------------------------------------------
+struct adc_cal {
+    int                 gain   [ADC_CHIP_CNT * ADC_CH_CNT];
+    int                 offset [ADC_CHIP_CNT * ADC_CH_CNT];
+};
+
+//------------------------------------------------------------------------------
+// Recovery 상태 (lib_i2cadc_recover.c)
+//------------------------------------------------------------------------------
+struct adc_recover {
+    struct adc_recovery_cfg cfg;
+    unsigned char       isolated;                   // 격리된 chip (bit = chip index)
+    unsigned char       fail      [ADC_CHIP_CNT];   // 연속 실패 scan 수
+    unsigned long long  probe_ns  [ADC_CHIP_CNT];   // 격리 chip의 다음 확인 시간
+    unsigned long long  probe_int [ADC_CHIP_CNT];   // 확인 간격 (ns)
+    int                 bus_fail;                   // 모든 chip이 실패한 연속 scan 수
+    struct adc_health   health;
+};
+
+//------------------------------------------------------------------------------
+// Board context (adc_board_t). board(I2C bus)별 상태를 저장함.
+//
+// pend_cmd[chip]은 chip에 마지막으로 전달한 command(= 진행/완료된 conversion의 channel)이며
+// 0이면 알 수 없음. 같은 channel을 다시 읽는 경우 pend_ns 이후 경과 시간이 conv_age_ns
+// 이내이면 dummy read(conversion 시작) 없이 바로 결과를 읽음.
+//------------------------------------------------------------------------------
+struct adc_board {
+    // i2c-dev fd (다른 backend는 -1), I2C backend
+    int                 fd;
+    const struct adc_bus_ops *ops;
+    void                *bus_ctx;
+    // 마지막 설정 slave address (-1 = 알 수 없음)
+    int                 addr;
+    // I2C_FUNCS 결과 (0 = 아직 확인하지 않음)
+    unsigned long       funcs;
+    // board description의 chip I2C address, chip (bit = chip index)
+    unsigned char       chip_addr [ADC_CHIP_CNT];
+    unsigned char       chips;
+    // 응답한 chip (bit = chip index, probe 전에는 모두 있는 것으로 처리)
+    unsigned char       present;
+
+    // chip별 진행중인 conversion command, 시작 시간
+    unsigned char       pend_cmd [ADC_CHIP_CNT];
+    unsigned long long  pend_ns  [ADC_CHIP_CNT];
+    unsigned long long  conv_age_ns;
+
+    // chip/channel별 input mode(ADC_MODE_xxx)와 mode로 만든 LTC2309 command
+    unsigned char       mode [ADC_CHIP_CNT * ADC_CH_CNT];
+    unsigned char       cmd  [ADC_CHIP_CNT * ADC_CH_CNT];
+    // scan 후 sleep 시킬 chip, 현재 sleep 중인 chip (bit = chip index), tREFWAKE
+    unsigned char       sleep_mask;
+    unsigned char       sleeping;
+    unsigned long long  refwake_ns;
+
+    struct adc_cal      cal;
+    struct adc_recover  rec;
+
+#if defined (__LIB_I2CADC_STATS__)
+    struct adc_bus_stats stats;
+#endif
+
+    // bus access lock (여러 thread에서 같은 board 사용시)
+    pthread_mutex_t     lock;
+};
+
+// probe에서 응답한 chip (adc_board_t.present)
+#define CHIP_PRESENT(b, c)  ((b)->present & (1 << (c)))
+// scan 대상 chip (응답하고 격리되지 않은 chip)
+#define CHIP_ACTIVE(b, c)   (CHIP_PRESENT(b, c) && !((b)->rec.isolated & (1 << (c))))
+
+// slave address 설정(board별 cache), adapter 지원 기능(I2C_FUNCS)
+extern int              bus_set_addr    (adc_board_t *b, unsigned char addr);
+extern unsigned long    bus_funcs       (adc_board_t *b);
+
+// bus transaction (모든 I2C access는 아래 함수를 사용)
+struct i2c_msg;
+extern int              bus_read_word   (adc_board_t *b, unsigned char cmd);
+extern int              bus_rdwr        (adc_board_t *b, struct i2c_msg *msg, int nmsgs);
+extern int              bus_read        (adc_board_t *b, unsigned char *buf, int len);
+extern int              bus_write       (adc_board_t *b, const unsigned char *buf, int len);
+
+// chip에 마지막으로 전달한 command 기록 (cmd = 0 : 알 수 없음), ts = 전달 시간
+extern void             chip_set_pend   (adc_board_t *b, int adc_idx, unsigned char cmd,
+                                         unsigned long long ts);
+
+// board description (lib_i2cadc_desc.c)
+extern const adc_pin_t  *desc_find      (const char *name, const char **hdr_name, int *pin_no, int *p_cnt);
+extern int              desc_chips      (unsigned char *addr);
+
+// bus error recovery (lib_i2cadc_recover.c)
+extern void             recover_init    (adc_board_t *b);
+extern int              recover_begin   (adc_board_t *b, int mask);
+extern unsigned long long recover_deadline (adc_board_t *b);
+extern int              recover_retry   (adc_board_t *b, unsigned long long now,
+                                         unsigned long long deadline, unsigned long long due,
+                                         unsigned long long *backoff);
+extern int              recover_bus_stuck (adc_board_t *b, int scanned, int failed);
+extern void             recover_end     (adc_board_t *b, int scanned, int failed);
+extern int              bus_recover     (adc_board_t *b);
+
+// calibration (lib_i2cadc_cal.c)
+extern int              cal_valid       (int gain, int offset);
+extern void             cal_reset       (struct adc_cal *cal);
+extern int              cal_mv          (const struct adc_cal *cal, int idx, unsigned short raw);
+extern void             cal_convert     (const struct adc_cal *cal, const unsigned short *raw,
+                                         int *mv, int cnt);
+
+//------------------------------------------------------------------------------
+// Bus statistics (lib_i2cadc_stats.c). __LIB_I2CADC_STATS__가 없으면 모두 제거됨.
+// 통계는 board lock 안에서 update 됨. (stream thread는 board를 단독으로 사용)
+//------------------------------------------------------------------------------
+#if defined (__LIB_I2CADC_STATS__)
+extern unsigned long long stat_now      (void);
+extern void             stat_end        (adc_board_t *b, int op, unsigned long long t0, int addr,
+                                         int trans, int bytes, int err);
+extern void             stat_rdwr       (adc_board_t *b, unsigned long long t0,
+                                         const struct i2c_msg *msg, int nmsgs, int err);
+extern void             stat_lookup     (adc_board_t *b, unsigned long long t0);
+
+#define STAT_VAR(t)                 unsigned long long t
+#define STAT_BEGIN(t)               ((t) = stat_now())
+#define STAT_END(b, op, t, addr, trans, bytes, err) \
+                                    stat_end (b, op, t, addr, trans, bytes, err)
+#define STAT_RDWR(b, t, msg, n, err) stat_rdwr (b, t, msg, n, err)
+#define STAT_LOOKUP(b, t)           stat_lookup (b, t)
+#define STAT_INC(b, field)          ((b)->stats.field++)
+#else
+#define STAT_VAR(t)
+#define STAT_BEGIN(t)               ((void)0)
+#define STAT_END(b, op, t, addr, trans, bytes, err) ((void)0)
+#define STAT_RDWR(b, t, msg, n, err) ((void)0)
+#define STAT_LOOKUP(b, t)           ((void)0)
+#define STAT_INC(b, field)          ((void)0)
+#endif
+
+//------------------------------------------------------------------------------
+#endif  // __LIB_I2CADC_PRIV_H__
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
@@ -0,0 +1,289 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_recover.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) bus error recovery for ODROID-JIG.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "lib_i2cadc.h"
+#include "lib_i2cadc_priv.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Bus error recovery. scan(scan_items)에서 실패한 chip을 다음과 같이 처리함.
+//
+//  - retry : 실패한 chip만 backoff_us부터 2배씩 늘어나는 간격으로 최대 retry_max회 다시
+//            읽음. 모든 retry는 scan당 budget_us 안에서만 진행. (scan 시간 제한)
+//            board lock 안에서 sleep 하지 않도록 다른 chip을 모두 읽은 후 backoff 시간이
+//            지난 chip만 retry 하며, 아직 backoff 시간 전인 chip은 이번 scan에서 ERR로
+//            처리하고 다음 scan에서 다시 읽음. (1개 chip의 실패가 다른 chip의 주기에 영향 없음)
+//  - error : retry 후에도 실패한 chip의 sample은 ADC_FLAG_ERR (값 0)
+//  - bus   : scan한 모든 chip이 실패(여러 chip 또는 연속 2회)하면 SDA stuck 등 bus 문제로
+//            판단하고 backend의 recover(clock-out)를 호출하며, 성공하면 1회 더 읽음.
+//            i2c-dev는 clock-out을 할 수 없으므로(device node reopen만 진행) 항상 실패로 집계함.
+//  - 격리  : isolate_fail회 연속 실패한 chip은 scan에서 제외(ADC_FLAG_ISOLATED)하여 다른
+//            chip의 scan 시간/주기에 영향이 없도록 함. 격리된 chip은 probe_us 간격으로
+//            1회씩 확인하며 실패시 간격을 probe_max_us까지 2배씩 늘림. 응답하면 복귀.
+//
+// 모든 함수는 board lock 안에서 호출됨.
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static const struct adc_recovery_cfg DefaultRecovery = {
+    2,          // retry_max
+    50,         // backoff_us
+    1000,       // budget_us
+    3,          // isolate_fail
+    100000,     // probe_us
+    5000000,    // probe_max_us
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  unsigned long long now_ns       (void);
+static  void    chip_isolate            (adc_board_t *b, int c, unsigned long long now);
+
+        void    recover_init            (adc_board_t *b);
+        int     recover_begin           (adc_board_t *b, int mask);
+        unsigned long long recover_deadline (adc_board_t *b);
+        int     recover_retry           (adc_board_t *b, unsigned long long now,
+                                         unsigned long long deadline, unsigned long long due,
+                                         unsigned long long *backoff);
+        int     recover_bus_stuck       (adc_board_t *b, int scanned, int failed);
+        void    recover_end             (adc_board_t *b, int scanned, int failed);
+        int     bus_recover             (adc_board_t *b);
+
+        int     adc_board_set_recovery  (adc_board_t *b, const struct adc_recovery_cfg *cfg);
+        int     adc_board_health        (adc_board_t *b, struct adc_health *h, int reset);
+        int     adc_board_recover       (adc_board_t *b);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static unsigned long long now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+static void chip_isolate (adc_board_t *b, int c, unsigned long long now)
+{
+    struct adc_recover *r = &b->rec;
+
+    r->isolated     |= 1 << c;
+    r->probe_int [c] = r->cfg.probe_us * 1000ULL;
+    r->probe_ns  [c] = now + r->probe_int [c];
+    r->health.isolations++;
+    chip_set_pend (b, c, 0, 0);
+
+#if defined (__LIB_I2CADC_DEBUG__)
+    printf ("%s : fd = %d, chip %d isolated\n", __func__, b->fd, c);
+#endif
+}
+
+//------------------------------------------------------------------------------
+void recover_init (adc_board_t *b)
+{
+    memset(&b->rec, 0, sizeof(struct adc_recover));
+    b->rec.cfg = DefaultRecovery;
+}
+
+//------------------------------------------------------------------------------
+// scan 시작. 확인 시간이 된 격리 chip(mask 중)을 1회 read로 확인하여 응답하면 복귀시킴.
+// return : scan할 chip (mask 중 격리되지 않은 chip)
+//------------------------------------------------------------------------------
+int recover_begin (adc_board_t *b, int mask)
+{
+    struct adc_recover *r = &b->rec;
+    unsigned long long now;
+    int c;
+
+    if (mask & r->isolated) {
+        now = now_ns();
+        for (c = 0; c < ADC_CHIP_CNT; c++) {
+            if (!(mask & r->isolated & (1 << c)) || (now < r->probe_ns [c]))
+                continue;
+
+            if (!bus_set_addr(b, b->chip_addr[c]) && (bus_read_word(b, CH_CMD(b, c, 0)) >= 0)) {
+                r->isolated &= ~(1 << c);
+                r->fail [c]  = 0;
+                r->health.restores++;
+                chip_set_pend (b, c, 0, 0);
+                continue;
+            }
+            r->probe_int [c] *= 2;
+            if (r->probe_int [c] > r->cfg.probe_max_us * 1000ULL)
+                r->probe_int [c] = r->cfg.probe_max_us * 1000ULL;
+            r->probe_ns [c] = now + r->probe_int [c];
+        }
+    }
+    return mask & ~r->isolated;
+}
+
+//------------------------------------------------------------------------------
+// scan의 retry 제한 시간
+//------------------------------------------------------------------------------
+unsigned long long recover_deadline (adc_board_t *b)
+{
+    return now_ns() + b->rec.cfg.budget_us * 1000ULL;
+}
+
+//------------------------------------------------------------------------------
+// retry 시간 확인. (기다리지 않음) due = 마지막 실패 시간 + backoff
+// return 1 : retry 가능 (backoff 2배), 0 : backoff 시간 전, -1 : 제한 시간(deadline)을 넘음
+//------------------------------------------------------------------------------
+int recover_retry (adc_board_t *b, unsigned long long now, unsigned long long deadline,
+                   unsigned long long due, unsigned long long *backoff)
+{
+    if ((due > deadline) || (now > deadline))
+        return -1;
+    if (now < due)
+        return 0;
+
+    *backoff *= 2;
+    b->rec.health.retries++;
+    STAT_INC(b, retry);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+// scan한 모든 chip이 실패한 경우 bus 문제인지 판단. (여러 chip 동시 실패 또는 연속 2회)
+// return 1 : bus recovery 필요
+//------------------------------------------------------------------------------
+int recover_bus_stuck (adc_board_t *b, int scanned, int failed)
+{
+    if (!failed || (failed != scanned)) {
+        b->rec.bus_fail = 0;
+        return 0;
+    }
+    b->rec.bus_fail++;
+    return (__builtin_popcount(scanned) > 1) || (b->rec.bus_fail > 1);
+}
+
+//------------------------------------------------------------------------------
+// scan 종료. chip별 연속 실패 수를 기록하고 isolate_fail회 연속 실패한 chip을 격리함.
+//------------------------------------------------------------------------------
+void recover_end (adc_board_t *b, int scanned, int failed)
+{
+    struct adc_recover *r = &b->rec;
+    unsigned long long now = 0;
+    int c;
+
+    for (c = 0; c < ADC_CHIP_CNT; c++) {
+        if (!(scanned & (1 << c)))
+            continue;
+        if (!(failed & (1 << c))) {
+            r->fail [c] = 0;
+            continue;
+        }
+        r->health.failed [c]++;
+        if ((r->cfg.isolate_fail > 0) && (++r->fail [c] >= r->cfg.isolate_fail)) {
+            now = now ? now : now_ns();
+            chip_isolate (b, c, now);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// backend의 bus recovery. slave address, chip의 conversion 상태는 알 수 없게 됨.
+// return 0 : success, -1 : recovery 기능 없음 또는 실패
+//------------------------------------------------------------------------------
+int bus_recover (adc_board_t *b)
+{
+    int c, ret;
+
+    if (b->ops->recover == NULL)
+        return -1;
+
+    b->rec.health.bus_recover++;
+    if ((ret = b->ops->recover(b->bus_ctx) ? -1 : 0))
+        b->rec.health.bus_recover_fail++;
+
+    b->addr = -1;
+    for (c = 0; c < ADC_CHIP_CNT; c++)
+        chip_set_pend (b, c, 0, 0);
+
+#if defined (__LIB_I2CADC_DEBUG__)
+    printf ("%s : fd = %d, %s bus recovery %s\n", __func__, b->fd, b->ops->name, ret ? "fail" : "ok");
+#endif
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+// recovery 설정. cfg == NULL 이면 기본값. isolate_fail = 0 이면 격리하지 않음.
+// return 0 : success, -1 : 잘못된 설정
+//------------------------------------------------------------------------------
+int adc_board_set_recovery (adc_board_t *b, const struct adc_recovery_cfg *cfg)
+{
+    if (b == NULL)
+        return -1;
+
+    cfg = cfg ? cfg : &DefaultRecovery;
+    if ((cfg->retry_max < 0) || (cfg->backoff_us < 0) || (cfg->budget_us < 0) ||
+        (cfg->isolate_fail < 0) || (cfg->probe_us <= 0) || (cfg->probe_max_us < cfg->probe_us))
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    b->rec.cfg = *cfg;
+    pthread_mutex_unlock(&b->lock);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// recovery 상태/통계를 h에 복사함. reset != 0 이면 복사 후 통계 초기화. (격리 상태는 유지)
+// return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+int adc_board_health (adc_board_t *b, struct adc_health *h, int reset)
+{
+    if ((b == NULL) || (h == NULL))
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    *h = b->rec.health;
+    h->isolated = b->rec.isolated;
+    if (reset)
+        memset(&b->rec.health, 0, sizeof(struct adc_health));
+    pthread_mutex_unlock(&b->lock);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// bus recovery 후 격리된 chip을 모두 다시 확인하도록 함. (recovery 실패시에도 확인)
+// return 0 : success, -1 : fail 또는 recovery 기능 없음 (i2c-dev는 항상 -1)
+//------------------------------------------------------------------------------
+int adc_board_recover (adc_board_t *b)
+{
+    int c, ret;
+
+    if (b == NULL)
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    ret = bus_recover (b);
+    for (c = 0; c < ADC_CHIP_CNT; c++)
+        b->rec.probe_ns [c] = 0;
+    pthread_mutex_unlock(&b->lock);
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
@@ -0,0 +1,561 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_sampler.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) background sampler for ODROID-JIG.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+
+#include "lib_i2cadc.h"
+#include "lib_i2cadc_priv.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Sampler thread는 설정된 주기로 보드 전체(adc_board_snapshot)를 읽어서 table에 저장함.
+// table은 seqlock으로 보호되며 sampler(writer)는 1개, reader는 여러 thread가 가능함.
+//
+//  - writer : seq 홀수(쓰는중) -> table update -> seq 짝수(완료)
+//  - reader : seq가 짝수이고 copy 전/후 seq가 같을때까지 반복 (lock, syscall 없음)
+//
+// bus access는 board lock으로 보호되므로 sampler가 동작하는 동안 다른 thread에서
+// 같은 board를 읽을 수 있음. (sampler의 scan 사이에 처리됨)
+//
+// Window monitor. pin별 [min_mv, max_mv]를 등록하면 sampler가 scan마다 raw code로 비교하여
+// 상태(ADC_WIN_IN/LOW/HIGH)가 바뀐 경우에만 event를 queue에 추가함.
+//  - threshold는 등록시 calibration으로 raw code로 변환함. (이후 calibration 변경은 반영 안됨)
+//  - event queue는 writer(sampler) 1개, reader 1개의 lock-free ring이며
+//    event가 추가된 scan에서만 eventfd(adc_sampler_event_fd)에 1회 신호함.
+//  - queue가 가득 찬 경우 새로운 event는 버리고 overrun을 증가시킴.
+//
+// Accumulator. sampler가 scan마다 channel별 min/max/sum/sum of squares를 raw code(정수)로
+// 누적하며 adc_sampler_accum()이 현재 window의 통계를 가져오고 새로운 window를 시작함.
+//  - bank 2개(structure of arrays, field별 cache line 정렬)를 번갈아 사용함.
+//    reader는 active bank를 바꾼 후 writer가 이전 bank의 update를 끝낼 때까지 기다림.
+//    (acc_seq 홀수 = update 중) writer는 lock 없이 update 함.
+//  - mV 변환(calibration)은 읽을 때 1회만 처리함.
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+#define SCAN_CH_MAX     (ADC_CHIP_CNT * ADC_CH_CNT)
+#define EVENT_MAX       256
+#define CACHE_LINE      64
+
+struct acc_bank {
+    int64_t             sum     [SCAN_CH_MAX] __attribute__((aligned(CACHE_LINE)));
+    uint64_t            sum_sq  [SCAN_CH_MAX] __attribute__((aligned(CACHE_LINE)));
+    uint32_t            invalid [SCAN_CH_MAX] __attribute__((aligned(CACHE_LINE)));
+    int16_t             min     [SCAN_CH_MAX] __attribute__((aligned(CACHE_LINE)));
+    int16_t             max     [SCAN_CH_MAX];
+    uint64_t            scans;
+    unsigned long long  first_ns;
+    unsigned long long  last_ns;
+};
+
+struct window {
+    int                 on;
+    int                 min_raw;    // raw < min_raw : ADC_WIN_LOW
+    int                 max_raw;    // raw > max_raw : ADC_WIN_HIGH
+    int                 state;
+};
+
+struct adc_sampler {
+    adc_board_t         *board;
+    int                 period_us;
+    pthread_t           thread;
+    atomic_int          run;
+
+    // seqlock protected table
+    atomic_uint         seq;
+    struct adc_snapshot table;
+
+    // window monitor (pin handle index)
+    pthread_mutex_t     win_lock;
+    struct window       win [SCAN_CH_MAX];
+    int                 win_cnt;
+
+    // event queue (SPSC)
+    int                 efd;
+    struct adc_event    ev [EVENT_MAX];
+    unsigned int        ev_head;
+    unsigned int        ev_tail;
+    unsigned int        ev_overrun;         // queue full로 버려진 event 수 (누적)
+
+    // accumulator (active bank index, writer update seq, reader lock)
+    struct acc_bank     acc [2];
+    atomic_int          acc_active;
+    atomic_uint         acc_seq;
+    pthread_mutex_t     acc_lock;
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  void    timespec_add_us         (struct timespec *t, int us);
+static  int     raw_lower_bound         (adc_board_t *b, adc_pin_t pin, int mv);
+static  int     event_push              (struct adc_sampler *s, const struct adc_event *e);
+static  int     window_check            (struct adc_sampler *s, const struct adc_snapshot *snap);
+static  void    acc_reset               (struct acc_bank *a);
+static  void    acc_update              (struct adc_sampler *s, const struct adc_snapshot *snap);
+static  void    *sampler_thread         (void *arg);
+
+        struct adc_sampler *adc_sampler_start (adc_board_t *b, int period_us);
+        void    adc_sampler_stop        (struct adc_sampler *s);
+        int     adc_sampler_snapshot    (struct adc_sampler *s, struct adc_snapshot *snap);
+        int     adc_sampler_read        (struct adc_sampler *s, const char *name, int *read_value, int *cnt);
+        int     adc_sampler_changes     (struct adc_sampler *s, struct adc_delta *d,
+                                         struct adc_change *out, int max);
+        int     adc_sampler_watch       (struct adc_sampler *s, adc_pin_t pin, int min_mv, int max_mv);
+        int     adc_sampler_unwatch     (struct adc_sampler *s, adc_pin_t pin);
+        int     adc_sampler_event_fd    (struct adc_sampler *s);
+        int     adc_sampler_events      (struct adc_sampler *s, struct adc_event *ev, int max);
+        unsigned int adc_sampler_overrun (struct adc_sampler *s);
+        int     adc_sampler_accum       (struct adc_sampler *s, struct adc_accum *acc,
+                                         unsigned long long *first_ns, unsigned long long *last_ns);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static void timespec_add_us (struct timespec *t, int us)
+{
+    t->tv_nsec += (long)us * 1000;
+    while (t->tv_nsec >= 1000000000L) {
+        t->tv_nsec -= 1000000000L;
+        t->tv_sec++;
+    }
+}
+
+//------------------------------------------------------------------------------
+// pin의 calibration 변환값이 mv 이상이 되는 최소 raw code. 없으면 4096
+// (gain > 0 이므로 raw에 대해 단조 증가, bipolar channel은 -2048 ~ 2047의 int16)
+//------------------------------------------------------------------------------
+static int raw_lower_bound (adc_board_t *b, adc_pin_t pin, int mv)
+{
+    unsigned short raw;
+    int lo = -2048, hi = 4096, mid, v;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        raw = (unsigned short)mid;
+        adc_board_conv_mv (b, pin, &raw, &v, 1);
+        if (v >= mv)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    return lo;
+}
+
+//------------------------------------------------------------------------------
+static int event_push (struct adc_sampler *s, const struct adc_event *e)
+{
+    unsigned int head = s->ev_head;
+
+    if (head - __atomic_load_n(&s->ev_tail, __ATOMIC_ACQUIRE) >= EVENT_MAX) {
+        __atomic_store_n(&s->ev_overrun, s->ev_overrun + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    s->ev[head & (EVENT_MAX -1)] = *e;
+    __atomic_store_n(&s->ev_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+// 등록된 window를 snapshot의 raw code와 비교함. return : 추가한 event 수
+//------------------------------------------------------------------------------
+static int window_check (struct adc_sampler *s, const struct adc_snapshot *snap)
+{
+    struct adc_event e;
+    struct window *w;
+    int i, raw, state, cnt = 0;
+
+    pthread_mutex_lock(&s->win_lock);
+    for (i = 0; (i < SCAN_CH_MAX) && s->win_cnt; i++) {
+        if (!(w = &s->win[i])->on)
+            continue;
+        // bus error 등 유효하지 않은 sample은 window 상태를 변경하지 않음
+        if (snap->flags[i / ADC_CH_CNT][i % ADC_CH_CNT] & ADC_FLAG_INVALID)
+            continue;
+
+        raw   = (short)snap->raw[i / ADC_CH_CNT][i % ADC_CH_CNT];
+        state = (raw < w->min_raw) ? ADC_WIN_LOW : (raw > w->max_raw) ? ADC_WIN_HIGH : ADC_WIN_IN;
+        if (state == w->state)
+            continue;
+
+        w->state = state;
+        e.ts_ns  = snap->ts_ns;
+        e.pin    = i;
+        e.raw    = raw;
+        e.state  = state;
+        e.mv     = snap->mv[i / ADC_CH_CNT][i % ADC_CH_CNT];
+        cnt += event_push (s, &e);
+    }
+    pthread_mutex_unlock(&s->win_lock);
+    return cnt;
+}
+
+//------------------------------------------------------------------------------
+static void acc_reset (struct acc_bank *a)
+{
+    int i;
+
+    memset(a, 0, sizeof(struct acc_bank));
+    for (i = 0; i < SCAN_CH_MAX; i++)
+        a->min[i] = INT16_MAX, a->max[i] = INT16_MIN;
+}
+
+//------------------------------------------------------------------------------
+// active bank에 snapshot의 raw code를 누적함. (writer = sampler thread)
+//------------------------------------------------------------------------------
+static void acc_update (struct adc_sampler *s, const struct adc_snapshot *snap)
+{
+    const unsigned short *raw = &snap->raw[0][0];
+    const unsigned char *flags = &snap->flags[0][0];
+    struct acc_bank *a;
+    unsigned int seq;
+    int i, r;
+
+    // seq 홀수 : update 중 (reader는 bank 변경 후 seq가 바뀔 때까지 기다림)
+    seq = atomic_load_explicit(&s->acc_seq, memory_order_relaxed);
+    atomic_store(&s->acc_seq, seq + 1);
+    a = &s->acc[atomic_load(&s->acc_active)];
+
+    for (i = 0; i < SCAN_CH_MAX; i++) {
+        // bus error 등 유효하지 않은 sample은 통계에서 제외
+        if (flags[i] & ADC_FLAG_INVALID) {
+            a->invalid[i]++;
+            continue;
+        }
+        // bipolar channel은 int16 raw
+        r = (short)raw[i];
+        a->sum[i]    += r;
+        a->sum_sq[i] += (uint32_t)(r * r);
+        a->min[i]     = (r < a->min[i]) ? r : a->min[i];
+        a->max[i]     = (r > a->max[i]) ? r : a->max[i];
+    }
+    if (!a->scans++)
+        a->first_ns = snap->ts_ns;
+    a->last_ns = snap->ts_ns;
+
+    atomic_store_explicit(&s->acc_seq, seq + 2, memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+static void *sampler_thread (void *arg)
+{
+    struct adc_sampler *s = (struct adc_sampler *)arg;
+    struct adc_snapshot snap;
+    struct timespec next;
+    unsigned int seq;
+    uint64_t one = 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (atomic_load_explicit(&s->run, memory_order_relaxed)) {
+        // 유효한 sample이 없는 scan도 flags/invalid 통계를 위해 table에 반영함
+        if (adc_board_snapshot (s->board, &snap) >= 0) {
+            seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+            snap.seq = (seq + 2) >> 1;
+
+            // seq 홀수 : table update 중
+            atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+            atomic_thread_fence(memory_order_release);
+            memcpy(&s->table, &snap, sizeof(snap));
+            atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+
+            acc_update (s, &snap);
+
+            if (window_check (s, &snap) && (write(s->efd, &one, sizeof(one)) != sizeof(one)))
+                fprintf(stderr, "%s : eventfd write error\n", __func__);
+        }
+
+        if (s->period_us <= 0)
+            continue;
+
+        // 주기 유지 (scan 시간이 주기보다 긴 경우 현재 시간 기준으로 다시 시작)
+        timespec_add_us (&next, s->period_us);
+        if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL))
+            clock_gettime(CLOCK_MONOTONIC, &next);
+    }
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+// period_us 주기로 보드 전체를 sampling 하는 thread를 시작함. (period_us = 0 : 연속)
+//------------------------------------------------------------------------------
+struct adc_sampler *adc_sampler_start (adc_board_t *b, int period_us)
+{
+    struct adc_sampler *s;
+
+    if ((b == NULL) || (period_us < 0))
+        return NULL;
+
+    // accumulator bank가 cache line 정렬되어야 하므로 calloc 대신 posix_memalign 사용
+    if (posix_memalign((void **)&s, CACHE_LINE, sizeof(struct adc_sampler)))
+        return NULL;
+    memset(s, 0, sizeof(struct adc_sampler));
+
+    if ((s->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        free (s);
+        return NULL;
+    }
+    pthread_mutex_init(&s->win_lock, NULL);
+    pthread_mutex_init(&s->acc_lock, NULL);
+    acc_reset (&s->acc[0]);
+    acc_reset (&s->acc[1]);
+    atomic_init(&s->acc_active, 0);
+    atomic_init(&s->acc_seq, 0);
+
+    s->board     = b;
+    s->period_us = period_us;
+    atomic_init(&s->run, 1);
+    atomic_init(&s->seq, 0);
+
+    if (pthread_create(&s->thread, NULL, sampler_thread, s)) {
+        pthread_mutex_destroy(&s->win_lock);
+        pthread_mutex_destroy(&s->acc_lock);
+        close (s->efd);
+        free (s);
+        return NULL;
+    }
+    return s;
+}
+
+//------------------------------------------------------------------------------
+void adc_sampler_stop (struct adc_sampler *s)
+{
+    if (s == NULL)
+        return;
+
+    atomic_store(&s->run, 0);
+    pthread_join(s->thread, NULL);
+    pthread_mutex_destroy(&s->win_lock);
+    pthread_mutex_destroy(&s->acc_lock);
+    close (s->efd);
+    free (s);
+}
+
+//------------------------------------------------------------------------------
+// 최신 sampling 결과를 snap으로 복사함. (seqlock read)
+// return 1 : success, 0 : 아직 sampling 결과가 없음, -1 : error
+//------------------------------------------------------------------------------
+int adc_sampler_snapshot (struct adc_sampler *s, struct adc_snapshot *snap)
+{
+    unsigned int seq;
+
+    if ((s == NULL) || (snap == NULL))
+        return -1;
+
+    do {
+        while ((seq = atomic_load_explicit(&s->seq, memory_order_acquire)) & 1)
+            ;
+        memcpy(snap, &s->table, sizeof(struct adc_snapshot));
+        atomic_thread_fence(memory_order_acquire);
+    } while (seq != atomic_load_explicit(&s->seq, memory_order_relaxed));
+
+    return seq ? 1 : 0;
+}
+
+//------------------------------------------------------------------------------
+// adc_board_read()와 동일한 형식으로 최신 sampling 결과에서 header/pin의 mV값을 가져옴.
+//------------------------------------------------------------------------------
+int adc_sampler_read (struct adc_sampler *s, const char *name, int *read_value, int *cnt)
+{
+    struct adc_snapshot snap;
+    int ret;
+
+    if ((ret = adc_sampler_snapshot (s, &snap)) <= 0)
+        return ret;
+
+    return adc_snapshot_read (&snap, name, read_value, cnt);
+}
+
+//------------------------------------------------------------------------------
+// 최신 sampling 결과에서 d(consumer의 change detection context) 기준으로 변한 pin만 가져옴.
+// 이전 호출 이후 새로운 scan이 없으면 0. return : 변한 pin 수, -1 : error
+//------------------------------------------------------------------------------
+int adc_sampler_changes (struct adc_sampler *s, struct adc_delta *d, struct adc_change *out, int max)
+{
+    struct adc_snapshot snap;
+    int ret;
+
+    if ((ret = adc_sampler_snapshot (s, &snap)) <= 0)
+        return ret;
+
+    return adc_delta_update (d, &snap, out, max);
+}
+
+//------------------------------------------------------------------------------
+// pin의 window 등록(변경). 처음 상태는 ADC_WIN_IN으로 처리하므로 window를 벗어난 경우
+// 첫 scan에서 event가 발생함. return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+int adc_sampler_watch (struct adc_sampler *s, adc_pin_t pin, int min_mv, int max_mv)
+{
+    int min_raw, max_raw;
+
+    if ((s == NULL) || (pin >= SCAN_CH_MAX) || (min_mv > max_mv))
+        return -1;
+
+    min_raw = raw_lower_bound (s->board, pin, min_mv);
+    max_raw = raw_lower_bound (s->board, pin, max_mv + 1) - 1;
+
+    pthread_mutex_lock(&s->win_lock);
+    s->win_cnt += s->win[pin].on ? 0 : 1;
+    s->win[pin].on      = 1;
+    s->win[pin].min_raw = min_raw;
+    s->win[pin].max_raw = max_raw;
+    s->win[pin].state   = ADC_WIN_IN;
+    pthread_mutex_unlock(&s->win_lock);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+int adc_sampler_unwatch (struct adc_sampler *s, adc_pin_t pin)
+{
+    if ((s == NULL) || (pin >= SCAN_CH_MAX))
+        return -1;
+
+    pthread_mutex_lock(&s->win_lock);
+    s->win_cnt -= s->win[pin].on ? 1 : 0;
+    s->win[pin].on = 0;
+    pthread_mutex_unlock(&s->win_lock);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// window event 알림용 eventfd. (EPOLLIN : queue에 event가 있음)
+//------------------------------------------------------------------------------
+int adc_sampler_event_fd (struct adc_sampler *s)
+{
+    return s ? s->efd : -1;
+}
+
+//------------------------------------------------------------------------------
+// queue에서 최대 max개의 event를 꺼냄. (non-blocking, reader 1개)
+// return : 꺼낸 event 수
+//------------------------------------------------------------------------------
+int adc_sampler_events (struct adc_sampler *s, struct adc_event *ev, int max)
+{
+    unsigned int tail, head;
+    uint64_t cnt;
+    int n;
+
+    if ((s == NULL) || (ev == NULL))
+        return -1;
+
+    // eventfd 초기화 후 queue 확인 (이후 추가된 event는 다시 신호됨)
+    if (read(s->efd, &cnt, sizeof(cnt)) < 0)
+        cnt = 0;
+
+    tail = s->ev_tail;
+    head = __atomic_load_n(&s->ev_head, __ATOMIC_ACQUIRE);
+
+    for (n = 0; (tail != head) && (n < max); n++, tail++)
+        ev[n] = s->ev[tail & (EVENT_MAX -1)];
+
+    __atomic_store_n(&s->ev_tail, tail, __ATOMIC_RELEASE);
+
+    // 남은 event가 있으면 다시 신호
+    if (tail != head) {
+        cnt = 1;
+        if (write(s->efd, &cnt, sizeof(cnt)) != sizeof(cnt))
+            fprintf(stderr, "%s : eventfd write error\n", __func__);
+    }
+    return n;
+}
+
+//------------------------------------------------------------------------------
+// queue가 가득 차서 버려진 event 수 (시작 이후 누적). 이전 값과 비교하여 event 유실을 확인함.
+//------------------------------------------------------------------------------
+unsigned int adc_sampler_overrun (struct adc_sampler *s)
+{
+    return s ? __atomic_load_n(&s->ev_overrun, __ATOMIC_RELAXED) : 0;
+}
+
+//------------------------------------------------------------------------------
+// 현재 window(시작 또는 이전 호출 이후)의 channel별 통계를 acc[chip/channel]에 저장하고
+// 새로운 window를 시작함. (read and reset, sample copy 없음)
+// first_ns, last_ns != NULL이면 window의 첫/마지막 scan 시간. (scan이 없으면 0)
+// return : window의 scan 수, -1 : error
+//------------------------------------------------------------------------------
+int adc_sampler_accum (struct adc_sampler *s, struct adc_accum *acc,
+                       unsigned long long *first_ns, unsigned long long *last_ns)
+{
+    struct acc_bank *a;
+    unsigned int seq;
+    double mean, mean_sq, var, gain, offset, sq;
+    int i, old, scans;
+    long long cnt;
+
+    if ((s == NULL) || (acc == NULL))
+        return -1;
+
+    pthread_mutex_lock(&s->acc_lock);
+
+    // bank 변경 후 writer가 이전 bank를 update 중이면 끝날 때까지 기다림
+    old = atomic_load(&s->acc_active);
+    atomic_store(&s->acc_active, old ^ 1);
+    if ((seq = atomic_load(&s->acc_seq)) & 1)
+        while (atomic_load_explicit(&s->acc_seq, memory_order_acquire) == seq)
+            ;
+    atomic_thread_fence(memory_order_acquire);
+    a = &s->acc[old];
+
+    for (i = 0; i < SCAN_CH_MAX; i++) {
+        memset(&acc[i], 0, sizeof(struct adc_accum));
+        cnt = (long long)a->scans - a->invalid[i];
+        acc[i].samples = cnt;
+        acc[i].invalid = a->invalid[i];
+        if (cnt <= 0)
+            continue;
+        acc[i].stat.samples = (cnt > INT_MAX) ? INT_MAX : (int)cnt;
+
+        pthread_mutex_lock(&s->board->lock);
+        gain   = s->board->cal.gain[i];
+        offset = s->board->cal.offset[i];
+        acc[i].stat.min_mv = cal_mv (&s->board->cal, i, (unsigned short)a->min[i]);
+        acc[i].stat.max_mv = cal_mv (&s->board->cal, i, (unsigned short)a->max[i]);
+        pthread_mutex_unlock(&s->board->lock);
+
+        // raw 통계 -> mV (Q16 calibration : mV = (raw * gain + offset) / 65536)
+        mean    = (double)a->sum[i] / cnt;
+        mean_sq = (double)a->sum_sq[i] / cnt;
+        var     = mean_sq - mean * mean;
+        sq      = gain * gain * mean_sq + 2 * gain * offset * mean + offset * offset;
+
+        acc[i].stat.mean_mv   = (int)floor((mean * gain + offset) / 65536);
+        acc[i].stat.stddev_uv = (var > 0) ? (int)(sqrt(var) * fabs(gain) * 1000 / 65536) : 0;
+        acc[i].rms_uv         = (sq > 0) ? (int)(sqrt(sq) * 1000 / 65536) : 0;
+    }
+    scans = (int)a->scans;
+    if (first_ns)
+        *first_ns = a->first_ns;
+    if (last_ns)
+        *last_ns = a->last_ns;
+
+    acc_reset (a);
+    pthread_mutex_unlock(&s->acc_lock);
+    return scans;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
@@ -0,0 +1,500 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_sched.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) per-pin rate scheduler (slot table).
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "lib_i2cadc.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Rate scheduler. pin별 목표 rate(Hz)로 반복되는 slot table을 만들고 table 순서대로 읽음.
+//
+//  - tick 주기 = cfg.tick_us (0 : 가장 높은 목표 rate의 주기)
+//  - pin은 k tick(= tick rate / 목표 rate)마다 1회 배치됨. table 길이는 모든 k의 최소공배수
+//    이며 SCHED_SLOT_MAX를 넘는 pin의 k는 가장 가까운 값으로 조정됨. (planned_hz로 확인)
+//  - pin의 시작 tick(phase)은 tick별 pin 수가 가장 적고, 같은 chip이 이미 있는 tick을
+//    우선 선택하여 tick 안의 chip 변경(address 설정)이 적도록 배치함.
+//  - cfg.slot_pins > 0 이면 tick당 pin 수를 제한함. (bus 용량) 높은 priority의 pin부터
+//    배치하며 자리가 없는 pin은 k를 늘려서(rate를 낮춰서) 배치함.
+//  - tick 안의 pin은 chip/channel 순서로 1번의 scan(adc_board_read_flags)으로 읽음.
+//  - periodic scan과 같이 절대 시간 deadline을 사용하며 늦은 경우 놓친 tick은 건너뜀.
+//    slot table은 건너뛰지 않고 순서대로 진행하므로 bus 용량이 부족하면 일부 pin이 빠지지
+//    않고 모든 pin의 rate가 같은 비율로 낮아짐. (achieved_hz / planned_hz)
+//
+// 요청/배치/실제 rate는 adc_sched_rates()로 확인함.
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+#define SCHED_PIN_MAX   (ADC_CHIP_CNT * ADC_CH_CNT)
+#define SCHED_SLOT_MAX  1000
+
+struct sched_pin {
+    struct adc_sched_pin cfg;
+    int                 period;                 // slot table 배치 주기 (tick, 0 : 배치 안됨)
+    int                 phase;
+    unsigned long long  samples;                // 정상적으로 읽은 sample 수
+};
+
+struct adc_sched {
+    adc_board_t         *board;
+    struct adc_sched_cfg cfg;
+    struct sched_pin    pins [SCHED_PIN_MAX];
+
+    // slot table (tick별 pin, bit = pin handle), tick 주기
+    unsigned long long  *slot;
+    int                 slots;
+    unsigned long long  tick_ns;
+
+    pthread_t           thread;
+    atomic_int          run;
+
+    // 통계 (RT thread에서 사용하므로 priority inheritance lock)
+    pthread_mutex_t     stat_lock;
+    struct adc_timing   timing;
+    long long           jitter_sum;
+    unsigned long long  stat_ns;                // 통계 시작 시간
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  unsigned long long  ts_to_ns    (const struct timespec *t);
+static  void    ns_to_ts                (unsigned long long ns, struct timespec *t);
+static  unsigned long long  now_ns      (void);
+static  int     gcd                     (int a, int b);
+static  int     sched_period            (int k, int *slots);
+static  int     sched_place_cost        (struct adc_sched *s, const unsigned short *load,
+                                         const unsigned char *chips, int adc_idx,
+                                         int period, int phase);
+static  int     sched_place             (struct adc_sched *s, unsigned short *load,
+                                         unsigned char *chips, struct sched_pin *p);
+static  int     sched_build             (struct adc_sched *s);
+static  void    timing_update           (struct adc_sched *s, long long jitter,
+                                         unsigned long long scan_ns, unsigned long long missed);
+static  void    *sched_thread           (void *arg);
+static  int     thread_attr_setup       (pthread_attr_t *attr, int priority, int cpu);
+
+        struct adc_sched *adc_sched_start (adc_board_t *b, const struct adc_sched_cfg *cfg);
+        void    adc_sched_stop          (struct adc_sched *s);
+        int     adc_sched_rates         (struct adc_sched *s, struct adc_sched_rate *r, int max, int reset);
+        int     adc_sched_timing        (struct adc_sched *s, struct adc_timing *t, int reset);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static unsigned long long ts_to_ns (const struct timespec *t)
+{
+    return (unsigned long long)t->tv_sec * 1000000000ULL + t->tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+static void ns_to_ts (unsigned long long ns, struct timespec *t)
+{
+    t->tv_sec  = ns / 1000000000ULL;
+    t->tv_nsec = ns % 1000000000ULL;
+}
+
+//------------------------------------------------------------------------------
+static unsigned long long now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts_to_ns (&ts);
+}
+
+//------------------------------------------------------------------------------
+static int gcd (int a, int b)
+{
+    int t;
+
+    while (b)
+        t = a % b, a = b, b = t;
+    return a;
+}
+
+//------------------------------------------------------------------------------
+// 배치 주기 k를 table 길이(*slots)에 맞춤. table 길이가 SCHED_SLOT_MAX를 넘지 않는
+// 가장 가까운 주기를 선택하고 *slots를 최소공배수로 변경함. return : 배치 주기
+//------------------------------------------------------------------------------
+static int sched_period (int k, int *slots)
+{
+    int d, c, l;
+
+    k = (k > SCHED_SLOT_MAX) ? SCHED_SLOT_MAX : k;
+
+    // k, k-1, k+1, k-2 ... 순서로 확인 (d = k 이하에서 *slots의 약수는 항상 있음)
+    for (d = 0; d < k; d++) {
+        for (c = k - d; c <= k + d; c += d ? 2 * d : 1) {
+            if ((c < 1) || (c > SCHED_SLOT_MAX))
+                continue;
+            l = *slots / gcd (*slots, c) * c;
+            if (l <= SCHED_SLOT_MAX) {
+                *slots = l;
+                return c;
+            }
+        }
+    }
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+// phase에 pin을 배치할 때의 cost. (tick 최대 pin 수가 우선, 같으면 chip이 추가되는 tick 수)
+// return -1 : slot_pins 제한으로 배치할 수 없음
+//------------------------------------------------------------------------------
+static int sched_place_cost (struct adc_sched *s, const unsigned short *load,
+                             const unsigned char *chips, int adc_idx, int period, int phase)
+{
+    int i, max = 0, add = 0;
+
+    for (i = phase; i < s->slots; i += period) {
+        if ((s->cfg.slot_pins > 0) && (load[i] >= s->cfg.slot_pins))
+            return -1;
+        max  = (load[i] > max) ? load[i] : max;
+        add += (chips[i] & (1 << adc_idx)) ? 0 : 1;
+    }
+    return max * (SCHED_SLOT_MAX + 1) + add;
+}
+
+//------------------------------------------------------------------------------
+// pin을 cost가 가장 작은 phase에 배치. 자리가 없으면 주기를 배수(table 길이의 약수)로 늘림.
+// return 0 : success, -1 : 배치할 수 없음 (period = 0)
+//------------------------------------------------------------------------------
+static int sched_place (struct adc_sched *s, unsigned short *load,
+                        unsigned char *chips, struct sched_pin *p)
+{
+    int adc_idx = p->cfg.pin / ADC_CH_CNT, ph, cost, best, i;
+
+    while (p->period <= s->slots) {
+        for (ph = 0, best = -1; ph < p->period; ph++) {
+            if ((cost = sched_place_cost (s, load, chips, adc_idx, p->period, ph)) < 0)
+                continue;
+            if ((best < 0) || (cost < best))
+                best = cost, p->phase = ph;
+        }
+        if (best >= 0) {
+            for (i = p->phase; i < s->slots; i += p->period) {
+                s->slot[i] |= 1ULL << p->cfg.pin;
+                load[i]++;
+                chips[i] |= 1 << adc_idx;
+            }
+            return 0;
+        }
+        // 다음 배수 주기
+        for (i = p->period + 1; (i <= s->slots) && ((s->slots % i) || (i % p->period)); i++)
+            ;
+        p->period = i;
+    }
+    p->period = 0;
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+// slot table 생성. return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+static int sched_build (struct adc_sched *s)
+{
+    struct sched_pin *order [SCHED_PIN_MAX], *t;
+    unsigned short load [SCHED_SLOT_MAX];
+    unsigned char chips [SCHED_SLOT_MAX];
+    unsigned long long tick_hz;
+    int i, j, k, n = s->cfg.n;
+
+    // tick rate 기준 pin별 배치 주기
+    tick_hz = 1000000000ULL / s->tick_ns;
+    for (i = 0; i < n; i++) {
+        k = (int)((tick_hz + s->pins[i].cfg.rate_hz / 2) / s->pins[i].cfg.rate_hz);
+        s->pins[i].period = (k < 1) ? 1 : k;
+        order[i] = &s->pins[i];
+    }
+
+    // 짧은 주기(높은 rate)부터 table 길이를 정하여 높은 rate를 우선 유지
+    for (i = 1; i < n; i++)
+        for (j = i; (j > 0) && (order[j]->period < order[j - 1]->period); j--)
+            t = order[j], order[j] = order[j - 1], order[j - 1] = t;
+
+    s->slots = 1;
+    for (i = 0; i < n; i++)
+        order[i]->period = sched_period (order[i]->period, &s->slots);
+
+    if ((s->slot = calloc(s->slots, sizeof(unsigned long long))) == NULL)
+        return -1;
+
+    // 높은 priority, 짧은 주기 순서로 배치
+    for (i = 1; i < n; i++)
+        for (j = i; j > 0; j--) {
+            if ((order[j]->cfg.priority < order[j - 1]->cfg.priority) ||
+                ((order[j]->cfg.priority == order[j - 1]->cfg.priority) &&
+                 (order[j]->period >= order[j - 1]->period)))
+                break;
+            t = order[j], order[j] = order[j - 1], order[j - 1] = t;
+        }
+
+    memset(load,  0, sizeof(load));
+    memset(chips, 0, sizeof(chips));
+    for (i = 0; i < n; i++) {
+        if (sched_place (s, load, chips, order[i]))
+            fprintf(stderr, "%s : pin %s (%d Hz) not scheduled (slot_pins = %d)\n",
+                __func__, adc_pin_name(order[i]->cfg.pin), order[i]->cfg.rate_hz, s->cfg.slot_pins);
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+static void timing_update (struct adc_sched *s, long long jitter,
+                           unsigned long long scan_ns, unsigned long long missed)
+{
+    struct adc_timing *t = &s->timing;
+
+    if (!t->scans || (jitter < t->jitter_min_ns))
+        t->jitter_min_ns = jitter;
+    if (!t->scans || (jitter > t->jitter_max_ns))
+        t->jitter_max_ns = jitter;
+
+    t->scans++;
+    t->missed        += missed;
+    t->scan_max_ns    = (scan_ns > t->scan_max_ns) ? scan_ns : t->scan_max_ns;
+    s->jitter_sum    += jitter;
+    t->jitter_avg_ns  = s->jitter_sum / (long long)t->scans;
+}
+
+//------------------------------------------------------------------------------
+static void *sched_thread (void *arg)
+{
+    struct adc_sched *s = (struct adc_sched *)arg;
+    adc_pin_t pins [SCHED_PIN_MAX];
+    unsigned char flags [SCHED_PIN_MAX];
+    int mv [SCHED_PIN_MAX];
+    unsigned long long deadline, start, end, missed, mask;
+    unsigned char pin_idx [SCHED_PIN_MAX];
+    struct timespec ts;
+    long long jitter;
+    int i, n, slot = 0;
+
+    // pin handle -> s->pins index
+    for (i = 0; i < s->cfg.n; i++)
+        pin_idx[s->pins[i].cfg.pin] = i;
+
+    deadline = now_ns() + s->tick_ns;
+
+    while (atomic_load_explicit(&s->run, memory_order_relaxed)) {
+        ns_to_ts (deadline, &ts);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+
+        start = now_ns();
+
+        // tick의 pin (chip/channel 순서)
+        for (n = 0, mask = s->slot[slot]; mask; mask &= mask - 1)
+            pins[n++] = __builtin_ctzll(mask);
+
+        if (n) {
+            adc_board_read_flags (s->board, pins, n, mv, flags);
+            if (s->cfg.sample)
+                s->cfg.sample (start, pins, mv, flags, n, s->cfg.arg);
+        }
+        end    = now_ns();
+        jitter = (long long)(start - deadline);
+
+        // 다음 deadline을 이미 지난 경우 놓친 tick을 건너뜀 (slot table은 다음 slot부터 진행)
+        deadline += s->tick_ns;
+        missed    = (end > deadline) ? (end - deadline) / s->tick_ns + 1 : 0;
+        deadline += missed * s->tick_ns;
+
+        pthread_mutex_lock(&s->stat_lock);
+        for (i = 0; i < n; i++)
+            if (!(flags[i] & ADC_FLAG_INVALID))
+                s->pins[pin_idx[pins[i]]].samples++;
+        timing_update (s, jitter, end - start, missed);
+        pthread_mutex_unlock(&s->stat_lock);
+
+        slot = (slot + 1) % s->slots;
+    }
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+// priority > 0 이면 SCHED_FIFO, cpu >= 0 이면 CPU affinity 설정. return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+static int thread_attr_setup (pthread_attr_t *attr, int priority, int cpu)
+{
+    struct sched_param param;
+    cpu_set_t cpus;
+
+    if (priority > 0) {
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = priority;
+        if (pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED) ||
+            pthread_attr_setschedpolicy(attr, SCHED_FIFO) ||
+            pthread_attr_setschedparam(attr, &param))
+            return -1;
+    }
+    if (cpu >= 0) {
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        if (pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus))
+            return -1;
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// cfg.pins[cfg.n]의 목표 rate로 slot table을 만들고 scheduler thread를 시작함.
+// 같은 pin을 여러번 지정하거나 rate_hz <= 0 이면 잘못된 설정.
+// return NULL : 잘못된 설정 또는 thread 생성 실패
+//------------------------------------------------------------------------------
+struct adc_sched *adc_sched_start (adc_board_t *b, const struct adc_sched_cfg *cfg)
+{
+    unsigned long long used = 0;
+    struct adc_sched *s;
+    pthread_mutexattr_t mattr;
+    pthread_attr_t attr;
+    int i, ret, rate_max = 0;
+
+    if ((b == NULL) || (cfg == NULL) || (cfg->pins == NULL) || (cfg->tick_us < 0))
+        return NULL;
+    if ((cfg->n <= 0) || (cfg->n > SCHED_PIN_MAX) || (cfg->slot_pins < 0))
+        return NULL;
+    if ((cfg->priority < 0) || (cfg->priority > sched_get_priority_max(SCHED_FIFO)))
+        return NULL;
+    if (cfg->cpu >= CPU_SETSIZE)
+        return NULL;
+
+    for (i = 0; i < cfg->n; i++) {
+        if ((cfg->pins[i].pin >= SCHED_PIN_MAX) || (cfg->pins[i].rate_hz <= 0) ||
+            (used & (1ULL << cfg->pins[i].pin)))
+            return NULL;
+        used    |= 1ULL << cfg->pins[i].pin;
+        rate_max = (cfg->pins[i].rate_hz > rate_max) ? cfg->pins[i].rate_hz : rate_max;
+    }
+
+    if ((s = calloc(1, sizeof(struct adc_sched))) == NULL)
+        return NULL;
+
+    s->board   = b;
+    s->cfg     = *cfg;
+    s->tick_ns = cfg->tick_us ? cfg->tick_us * 1000ULL : 1000000000ULL / rate_max;
+    s->tick_ns = s->tick_ns ? s->tick_ns : 1;
+    for (i = 0; i < cfg->n; i++)
+        s->pins[i].cfg = cfg->pins[i];
+
+    if (sched_build (s)) {
+        free (s);
+        return NULL;
+    }
+    atomic_init(&s->run, 1);
+
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&s->stat_lock, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+
+    s->stat_ns = now_ns();
+
+    pthread_attr_init(&attr);
+    if ((ret = thread_attr_setup (&attr, cfg->priority, cfg->cpu)) == 0)
+        ret = pthread_create(&s->thread, &attr, sched_thread, s);
+    pthread_attr_destroy(&attr);
+
+    if (ret) {
+        fprintf(stderr, "%s : thread create error (priority = %d, cpu = %d) : %s\n",
+            __func__, cfg->priority, cfg->cpu, strerror(ret > 0 ? ret : EINVAL));
+        pthread_mutex_destroy(&s->stat_lock);
+        free (s->slot);
+        free (s);
+        return NULL;
+    }
+    return s;
+}
+
+//------------------------------------------------------------------------------
+void adc_sched_stop (struct adc_sched *s)
+{
+    if (s == NULL)
+        return;
+
+    atomic_store(&s->run, 0);
+    pthread_join(s->thread, NULL);
+    pthread_mutex_destroy(&s->stat_lock);
+    free (s->slot);
+    free (s);
+}
+
+//------------------------------------------------------------------------------
+// pin별 요청/배치/실제 rate를 r[max]에 저장함. (cfg.pins 순서)
+// achieved_hz는 시작(또는 마지막 reset) 이후의 평균. reset != 0 이면 복사 후 초기화.
+// return : 저장한 pin 수, -1 : error
+//------------------------------------------------------------------------------
+int adc_sched_rates (struct adc_sched *s, struct adc_sched_rate *r, int max, int reset)
+{
+    unsigned long long now;
+    double elapsed, tick_hz;
+    int i, n;
+
+    if ((s == NULL) || (r == NULL) || (max < 0))
+        return -1;
+
+    n       = (s->cfg.n < max) ? s->cfg.n : max;
+    tick_hz = 1e9 / (double)s->tick_ns;
+
+    pthread_mutex_lock(&s->stat_lock);
+    now     = now_ns();
+    elapsed = (double)(now - s->stat_ns) / 1e9;
+    for (i = 0; i < n; i++) {
+        r[i].pin          = s->pins[i].cfg.pin;
+        r[i].requested_hz = s->pins[i].cfg.rate_hz;
+        r[i].planned_hz   = s->pins[i].period ? tick_hz / s->pins[i].period : 0;
+        r[i].samples      = s->pins[i].samples;
+        r[i].achieved_hz  = (elapsed > 0) ? (double)s->pins[i].samples / elapsed : 0;
+    }
+    if (reset) {
+        for (i = 0; i < s->cfg.n; i++)
+            s->pins[i].samples = 0;
+        s->stat_ns = now;
+    }
+    pthread_mutex_unlock(&s->stat_lock);
+    return n;
+}
+
+//------------------------------------------------------------------------------
+// tick timing 통계를 t에 복사함. reset != 0 이면 복사 후 초기화.
+// return 0 : success, -1 : error
+//------------------------------------------------------------------------------
+int adc_sched_timing (struct adc_sched *s, struct adc_timing *t, int reset)
+{
+    if ((s == NULL) || (t == NULL))
+        return -1;
+
+    pthread_mutex_lock(&s->stat_lock);
+    *t = s->timing;
+    if (reset) {
+        memset(&s->timing, 0, sizeof(struct adc_timing));
+        s->jitter_sum = 0;
+    }
+    pthread_mutex_unlock(&s->stat_lock);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
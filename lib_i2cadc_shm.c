@@ -0,0 +1,280 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_shm.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) snapshot publication over POSIX shared memory.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lib_i2cadc.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Shared memory publication. bus를 사용하는 process(daemon, lib_i2cadc -d) 1개가
+// snapshot을 POSIX shared memory(shm_open)에 쓰고, 여러 client process가 읽음.
+//
+//  - segment = header(magic, version, seq ...) + struct adc_snapshot
+//  - seqlock : writer는 seq 홀수(쓰는중) -> snapshot copy -> seq 짝수(완료)
+//              reader는 seq가 짝수이고 copy 전/후 seq가 같을때까지 반복
+//  - client는 segment를 read-only로 mmap 한 후 syscall 없이 읽음.
+//    (writer가 쓰는 중에 종료된 경우 SHM_RETRY_MAX회 후 실패 처리)
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+#define SHM_MAGIC       0x41444353      // "SCDA"
+#define SHM_VERSION     2
+#define SHM_RETRY_MAX   100000
+
+struct shm_seg {
+    uint32_t            magic;
+    uint32_t            version;
+    uint32_t            size;           // sizeof(struct shm_seg)
+    uint32_t            pid;            // writer pid
+    atomic_uint         seq;
+    uint32_t            period_us;      // writer sampling 주기 (0 : 알 수 없음)
+    struct adc_snapshot snap;
+};
+
+struct adc_shm {
+    struct shm_seg      *seg;
+    int                 writer;
+    char                name [64];
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  struct adc_shm *shm_map         (const char *name, int writer);
+static  int     shm_begin               (const struct shm_seg *seg, unsigned int *seq);
+
+        struct adc_shm *adc_shm_create  (const char *name, int period_us);
+        int     adc_shm_publish         (struct adc_shm *shm, const struct adc_snapshot *snap);
+        struct adc_shm *adc_shm_open    (const char *name);
+        void    adc_shm_close           (struct adc_shm *shm);
+        int     adc_shm_snapshot        (struct adc_shm *shm, struct adc_snapshot *snap);
+        int     adc_shm_read_pins       (struct adc_shm *shm, const adc_pin_t *pins, int n,
+                                         int *read_value, unsigned long long *ts_ns);
+        int     adc_shm_read            (struct adc_shm *shm, const char *name, int *read_value, int *cnt);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static struct adc_shm *shm_map (const char *name, int writer)
+{
+    struct adc_shm *shm;
+    struct stat st;
+    int fd;
+
+    if ((name == NULL) || (strlen(name) >= sizeof(shm->name)))
+        return NULL;
+
+    if ((shm = calloc(1, sizeof(struct adc_shm))) == NULL)
+        return NULL;
+
+    if ((fd = shm_open(name, writer ? (O_RDWR | O_CREAT) : O_RDONLY, 0644)) < 0) {
+        fprintf(stderr, "%s : shm_open %s error : %s\n", __func__, name, strerror(errno));
+        free (shm);
+        return NULL;
+    }
+
+    if (writer && ftruncate(fd, sizeof(struct shm_seg)))
+        st.st_size = 0;
+    else if (fstat(fd, &st))
+        st.st_size = 0;
+
+    if ((size_t)st.st_size < sizeof(struct shm_seg)) {
+        fprintf(stderr, "%s : %s wrong size\n", __func__, name);
+        close (fd);
+        free (shm);
+        return NULL;
+    }
+
+    shm->seg = mmap(NULL, sizeof(struct shm_seg), writer ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                    MAP_SHARED, fd, 0);
+    close (fd);
+
+    if (shm->seg == MAP_FAILED) {
+        free (shm);
+        return NULL;
+    }
+    shm->writer = writer;
+    strcpy(shm->name, name);
+    return shm;
+}
+
+//------------------------------------------------------------------------------
+// seqlock read 시작. return 0 : success (seq), -1 : writer 없음 또는 쓰는 중 종료
+//------------------------------------------------------------------------------
+static int shm_begin (const struct shm_seg *seg, unsigned int *seq)
+{
+    int retry = SHM_RETRY_MAX;
+
+    while (((*seq = atomic_load_explicit(&seg->seq, memory_order_acquire)) & 1) && retry--)
+        ;
+    return ((*seq & 1) || !*seq) ? -1 : 0;
+}
+
+//------------------------------------------------------------------------------
+// writer : segment 생성. 같은 이름의 segment가 있으면 다시 사용(초기화)함.
+//------------------------------------------------------------------------------
+struct adc_shm *adc_shm_create (const char *name, int period_us)
+{
+    struct adc_shm *shm;
+
+    if ((shm = shm_map (name, 1)) == NULL)
+        return NULL;
+
+    memset(shm->seg, 0, sizeof(struct shm_seg));
+    shm->seg->size      = sizeof(struct shm_seg);
+    shm->seg->version   = SHM_VERSION;
+    shm->seg->pid       = getpid();
+    shm->seg->period_us = (period_us > 0) ? period_us : 0;
+    atomic_init(&shm->seg->seq, 0);
+    atomic_thread_fence(memory_order_release);
+    shm->seg->magic     = SHM_MAGIC;
+    return shm;
+}
+
+//------------------------------------------------------------------------------
+// writer : snapshot 게시 (seqlock write). snap->seq는 게시 번호로 변경됨.
+//------------------------------------------------------------------------------
+int adc_shm_publish (struct adc_shm *shm, const struct adc_snapshot *snap)
+{
+    unsigned int seq;
+
+    if ((shm == NULL) || !shm->writer || (snap == NULL))
+        return -1;
+
+    seq = atomic_load_explicit(&shm->seg->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&shm->seg->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&shm->seg->snap, snap, sizeof(struct adc_snapshot));
+    shm->seg->snap.seq = (seq + 2) >> 1;
+    atomic_store_explicit(&shm->seg->seq, seq + 2, memory_order_release);
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// client : segment를 read-only로 map. return NULL : 없음 또는 다른 version
+//------------------------------------------------------------------------------
+struct adc_shm *adc_shm_open (const char *name)
+{
+    struct adc_shm *shm;
+
+    if ((shm = shm_map (name, 0)) == NULL)
+        return NULL;
+
+    if ((shm->seg->magic != SHM_MAGIC) || (shm->seg->version != SHM_VERSION) ||
+        (shm->seg->size  != sizeof(struct shm_seg))) {
+        fprintf(stderr, "%s : %s is not adc snapshot segment\n", __func__, name);
+        adc_shm_close (shm);
+        return NULL;
+    }
+    return shm;
+}
+
+//------------------------------------------------------------------------------
+// writer는 segment를 삭제(shm_unlink)함. client는 unmap만 함.
+//------------------------------------------------------------------------------
+void adc_shm_close (struct adc_shm *shm)
+{
+    if (shm == NULL)
+        return;
+
+    munmap (shm->seg, sizeof(struct shm_seg));
+    if (shm->writer)
+        shm_unlink (shm->name);
+    free (shm);
+}
+
+//------------------------------------------------------------------------------
+// 최신 snapshot 전체 복사. return 1 : success, 0 : 게시된 snapshot 없음, -1 : error
+//------------------------------------------------------------------------------
+int adc_shm_snapshot (struct adc_shm *shm, struct adc_snapshot *snap)
+{
+    unsigned int seq;
+
+    if ((shm == NULL) || (snap == NULL))
+        return -1;
+
+    do {
+        if (shm_begin (shm->seg, &seq))
+            return 0;
+        memcpy(snap, &shm->seg->snap, sizeof(struct adc_snapshot));
+        atomic_thread_fence(memory_order_acquire);
+    } while (seq != atomic_load_explicit(&shm->seg->seq, memory_order_relaxed));
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+// pin handle[n]의 mV만 segment에서 직접 읽음. (snapshot copy 없음)
+// ts_ns != NULL이면 sampling 시간. return 1 : success, 0 : 게시된 snapshot 없음, -1 : error
+//------------------------------------------------------------------------------
+int adc_shm_read_pins (struct adc_shm *shm, const adc_pin_t *pins, int n,
+                       int *read_value, unsigned long long *ts_ns)
+{
+    const struct adc_snapshot *snap;
+    unsigned int seq;
+    int i;
+
+    if ((shm == NULL) || (pins == NULL) || (read_value == NULL) || (n < 0))
+        return -1;
+
+    snap = &shm->seg->snap;
+    do {
+        if (shm_begin (shm->seg, &seq))
+            return 0;
+        for (i = 0; i < n; i++)
+            read_value[i] = (pins[i] >= ADC_CHIP_CNT * ADC_CH_CNT) ? 0 :
+                            snap->mv[pins[i] / ADC_CH_CNT][pins[i] % ADC_CH_CNT];
+        if (ts_ns)
+            *ts_ns = snap->ts_ns;
+        atomic_thread_fence(memory_order_acquire);
+    } while (seq != atomic_load_explicit(&shm->seg->seq, memory_order_relaxed));
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+// adc_board_read()와 동일한 형식으로 header/pin의 mV값을 가져옴.
+//------------------------------------------------------------------------------
+int adc_shm_read (struct adc_shm *shm, const char *name, int *read_value, int *cnt)
+{
+    adc_pin_t pins [ADC_CHIP_CNT * ADC_CH_CNT];
+    int n, ret;
+
+    if ((shm == NULL) || (read_value == NULL) || (cnt == NULL))
+        return -1;
+
+    if ((n = adc_pin_resolve (name, pins, ADC_CHIP_CNT * ADC_CH_CNT)) <= 0)
+        return 0;
+
+    n = (n > ADC_CHIP_CNT * ADC_CH_CNT) ? ADC_CHIP_CNT * ADC_CH_CNT : n;
+    if ((ret = adc_shm_read_pins (shm, pins, n, read_value, NULL)) > 0)
+        *cnt = n;
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
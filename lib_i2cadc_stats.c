@@ -0,0 +1,160 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_stats.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) bus statistics for ODROID-JIG.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <linux/i2c.h>
+
+#include "lib_i2cadc.h"
+#include "lib_i2cadc_priv.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Bus statistics. __LIB_I2CADC_STATS__로 build한 경우 bus access 함수(bus_xxx)에서
+// transaction/byte/address 변경/retry/error 수와 op별 latency(log2 ns histogram)를 수집함.
+// 정의되지 않은 경우 수집 code는 모두 제거되며 adc_board_stats()는 -1을 돌려줌.
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+#if defined (__LIB_I2CADC_STATS__)
+static  int     stat_chip               (adc_board_t *b, int addr);
+static  int     stat_bin                (unsigned long long ns);
+        unsigned long long stat_now     (void);
+        void    stat_end                (adc_board_t *b, int op, unsigned long long t0, int addr,
+                                         int trans, int bytes, int err);
+        void    stat_rdwr               (adc_board_t *b, unsigned long long t0,
+                                         const struct i2c_msg *msg, int nmsgs, int err);
+        void    stat_lookup             (adc_board_t *b, unsigned long long t0);
+#endif
+        int     adc_board_stats         (adc_board_t *b, struct adc_bus_stats *st, int reset);
+
+#if defined (__LIB_I2CADC_STATS__)
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// slave address의 chip index. return -1 : ADC chip이 아님
+//------------------------------------------------------------------------------
+static int stat_chip (adc_board_t *b, int addr)
+{
+    int i;
+
+    for (i = 0; i < ADC_CHIP_CNT; i++)
+        if ((b->chips & (1 << i)) && (b->chip_addr[i] == addr))
+            return i;
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+// histogram bin = floor(log2(ns))
+//------------------------------------------------------------------------------
+static int stat_bin (unsigned long long ns)
+{
+    int bin = ns ? 63 - __builtin_clzll(ns) : 0;
+
+    return (bin < ADC_HIST_BINS) ? bin : ADC_HIST_BINS -1;
+}
+
+//------------------------------------------------------------------------------
+unsigned long long stat_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+// op 1회 기록. addr = 대상 chip address (-1 : 여러 chip 또는 알 수 없음)
+//------------------------------------------------------------------------------
+void stat_end (adc_board_t *b, int op, unsigned long long t0, int addr,
+               int trans, int bytes, int err)
+{
+    struct adc_bus_stats *st = &b->stats;
+    unsigned long long ns = stat_now() - t0;
+    int chip;
+
+    st->op    [op]++;
+    st->op_ns [op] += ns;
+    st->hist  [op][stat_bin (ns)]++;
+    st->trans += trans;
+    st->bytes += bytes;
+
+    if (op == ADC_OP_SET_ADDR)
+        st->addr_switch++;
+
+    if (err) {
+        if ((chip = stat_chip (b, addr)) < 0)
+            st->err_bus++;
+        else
+            st->err[chip]++;
+    }
+}
+
+//------------------------------------------------------------------------------
+// I2C_RDWR 기록. read message 수 = transaction 수. 1개 chip만 사용한 경우 chip error로 기록
+//------------------------------------------------------------------------------
+void stat_rdwr (adc_board_t *b, unsigned long long t0, const struct i2c_msg *msg, int nmsgs, int err)
+{
+    int i, trans = 0, bytes = 0, addr = nmsgs ? msg[0].addr : -1;
+
+    for (i = 0; i < nmsgs; i++) {
+        trans += (msg[i].flags & I2C_M_RD) ? 1 : 0;
+        bytes += msg[i].len;
+        addr   = (msg[i].addr == addr) ? addr : -1;
+    }
+    stat_end (b, ADC_OP_RDWR, t0, addr, trans, bytes, err);
+}
+
+//------------------------------------------------------------------------------
+// pin name 검색 기록. (board lock 밖에서 호출됨)
+//------------------------------------------------------------------------------
+void stat_lookup (adc_board_t *b, unsigned long long t0)
+{
+    pthread_mutex_lock(&b->lock);
+    stat_end (b, ADC_OP_LOOKUP, t0, -1, 0, 0, 0);
+    pthread_mutex_unlock(&b->lock);
+}
+#endif  // #if defined (__LIB_I2CADC_STATS__)
+
+//------------------------------------------------------------------------------
+// board의 통계를 st에 복사함. reset != 0 이면 복사 후 초기화.
+// return 0 : success, -1 : error 또는 통계 기능 없음(__LIB_I2CADC_STATS__)
+//------------------------------------------------------------------------------
+int adc_board_stats (adc_board_t *b, struct adc_bus_stats *st, int reset)
+{
+#if defined (__LIB_I2CADC_STATS__)
+    if ((b == NULL) || (st == NULL))
+        return -1;
+
+    pthread_mutex_lock(&b->lock);
+    *st = b->stats;
+    if (reset)
+        memset(&b->stats, 0, sizeof(struct adc_bus_stats));
+    pthread_mutex_unlock(&b->lock);
+    return 0;
+#else
+    (void)b, (void)reset;
+    if (st)
+        memset(st, 0, sizeof(struct adc_bus_stats));
+    return -1;
+#endif
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
@@ -0,0 +1,266 @@
+//------------------------------------------------------------------------------
+/**
+ * @file lib_i2cadc_stream.c
+ * @author charles-park (charles.park@hardkernel.com)
+ * @brief ADC board(LTC2309) single channel streaming capture for ODROID-JIG.
+ * @version 0.2
+ * @date 2023-10-11
+ *
+ * @package apt install minicom
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <linux/i2c.h>
+
+#include "lib_i2cadc.h"
+#include "lib_i2cadc_priv.h"
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+//
+// Streaming capture. 1개의 chip/channel을 연속으로 변환하여 ring buffer에 저장함.
+//
+// LTC2309는 DIN(command) 없이 read만 하는 경우 이전 설정을 유지하며,
+// read(2 byte) 후 STOP에서 같은 channel의 다음 conversion을 시작함. (Continuous Read)
+// 따라서 command를 1회 write한 후에는 sample당 2 byte read 1회로 처리됨.
+// adapter가 I2C_FUNC_I2C를 지원하지 않으면 같은 command로 i2c_read_word를 반복함.
+//
+// read로 받는 값은 이전 STOP에서 시작된 conversion 결과이므로 sample의 시간은
+// 이전 transaction의 종료 시간임.
+//
+// stream thread는 동작하는 동안 board lock을 가지고 있으므로 같은 board의 다른 호출
+// (read, snapshot, sampler ...)은 adc_stream_stop() 후에 처리됨.
+//
+// ring buffer는 호출자가 제공하며 writer(stream thread) 1개, reader 1개로 사용.
+// buffer가 가득 찬 경우 새로운 sample은 버리고 overrun을 증가시킴.
+//
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// 연속 read error 허용 횟수 (초과시 stream 종료)
+#define STREAM_ERR_MAX  100
+
+struct adc_stream {
+    adc_board_t         *board;
+    unsigned char       adc_idx;
+    unsigned char       ch_idx;
+    struct adc_ring     *ring;
+    pthread_t           thread;
+    atomic_int          run;
+    unsigned int        count;
+    int                 error;
+};
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// function prototype
+//------------------------------------------------------------------------------
+static  unsigned long long  now_ns      (void);
+static  void    ring_push               (struct adc_ring *r, unsigned long long ts, unsigned short raw);
+static  int     stream_read             (adc_board_t *b, int plain, unsigned char cmd);
+static  void    *stream_thread          (void *arg);
+
+        int     adc_ring_init           (struct adc_ring *r, struct adc_sample *buf, unsigned int size);
+        int     adc_ring_pop            (struct adc_ring *r, struct adc_sample *out, int max);
+        struct adc_stream *adc_stream_start (adc_board_t *b, adc_pin_t pin, struct adc_ring *r);
+        int     adc_stream_stop         (struct adc_stream *st);
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+static unsigned long long now_ns (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+static void ring_push (struct adc_ring *r, unsigned long long ts, unsigned short raw)
+{
+    unsigned int head = r->head;
+
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= r->size) {
+        r->overrun++;
+        return;
+    }
+    r->buf[head & (r->size -1)].ts_ns = ts;
+    r->buf[head & (r->size -1)].raw   = raw;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+//------------------------------------------------------------------------------
+// 이전 conversion 결과를 읽고 같은 channel의 다음 conversion을 시작함.
+// return : 12 bits adc value, -1 : read error
+//------------------------------------------------------------------------------
+static int stream_read (adc_board_t *b, int plain, unsigned char cmd)
+{
+    unsigned char buf[2];
+    int read_val;
+
+    if (plain) {
+        if (bus_read (b, buf, 2))
+            return -1;
+        return ((buf[0] << 8 | buf[1]) >> 4) & 0xFFF;
+    }
+
+    if ((read_val = bus_read_word (b, cmd)) < 0)
+        return -1;
+    return ((((read_val >> 8) & 0xFF) | ((read_val << 8) & 0xFF00)) >> 4) & 0xFFF;
+}
+
+//------------------------------------------------------------------------------
+static void *stream_thread (void *arg)
+{
+    struct adc_stream *st = (struct adc_stream *)arg;
+    unsigned char cmd;
+    unsigned long long ts, ts_conv;
+    int plain, bipolar, raw, err = 0;
+
+    // stream 동안 board(I2C bus)를 단독으로 사용 (adc_stream_stop까지)
+    pthread_mutex_lock(&st->board->lock);
+    cmd     = CH_CMD(st->board, st->adc_idx, st->ch_idx);
+    plain   = (bus_funcs (st->board) & I2C_FUNC_I2C) ? 1 : 0;
+    bipolar = (st->board->mode [st->adc_idx * ADC_CH_CNT + st->ch_idx] & ADC_MODE_BIPOLAR) ? 1 : 0;
+
+    // channel 설정 및 첫 conversion 시작 (STOP)
+    if (bus_set_addr (st->board, st->board->chip_addr [st->adc_idx]) ||
+        (plain ? bus_write (st->board, &cmd, 1) : (bus_read_word (st->board, cmd) < 0))) {
+        chip_set_pend (st->board, st->adc_idx, 0, 0);
+        pthread_mutex_unlock(&st->board->lock);
+        st->error = -1;
+        return NULL;
+    }
+
+    // sleep 중이던 chip은 command(SLP = 0)로 깨어남. reference 안정(tREFWAKE) 전의
+    // conversion 결과는 버리고 다시 시작함.
+    if (st->board->sleeping & (1 << st->adc_idx)) {
+        st->board->sleeping &= ~(1 << st->adc_idx);
+        usleep(st->board->refwake_ns / 1000);
+        stream_read (st->board, plain, cmd);
+    }
+    ts_conv = now_ns();
+
+    while (atomic_load_explicit(&st->run, memory_order_relaxed)) {
+        raw = stream_read (st->board, plain, cmd);
+        ts  = now_ns();
+
+        if (raw < 0) {
+            if (++err > STREAM_ERR_MAX) {
+                st->error = -1;
+                break;
+            }
+            ts_conv = ts;
+            continue;
+        }
+        err = 0;
+        ring_push (st->ring, ts_conv, bipolar ? RAW_SEXT12(raw) : raw);
+        st->count++;
+        ts_conv = ts;
+    }
+    // 종료 후 chip은 마지막 read의 STOP에서 같은 channel의 conversion을 진행함
+    chip_set_pend (st->board, st->adc_idx, err ? 0 : cmd, ts_conv);
+    pthread_mutex_unlock(&st->board->lock);
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+// size는 2의 승수(power of 2)여야 함.
+//------------------------------------------------------------------------------
+int adc_ring_init (struct adc_ring *r, struct adc_sample *buf, unsigned int size)
+{
+    if ((r == NULL) || (buf == NULL) || !size || (size & (size -1)))
+        return -1;
+
+    memset(r, 0, sizeof(struct adc_ring));
+    r->buf  = buf;
+    r->size = size;
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+// ring buffer에서 최대 max개의 sample을 꺼냄. return : 꺼낸 sample 수
+//------------------------------------------------------------------------------
+int adc_ring_pop (struct adc_ring *r, struct adc_sample *out, int max)
+{
+    unsigned int tail, head;
+    int n;
+
+    if ((r == NULL) || (out == NULL))
+        return -1;
+
+    tail = r->tail;
+    head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+    for (n = 0; (tail != head) && (n < max); n++, tail++)
+        out[n] = r->buf[tail & (r->size -1)];
+
+    __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+    return n;
+}
+
+//------------------------------------------------------------------------------
+// pin의 chip/channel을 연속 변환하는 stream thread를 시작함.
+// stream이 동작하는 동안 board(I2C bus)는 stream thread가 단독으로 사용하며(board lock)
+// 다른 thread의 같은 board 호출은 stream 종료까지 기다림.
+// return NULL : 잘못된 pin, 응답하지 않거나 격리된 chip의 pin, thread 생성 실패
+//------------------------------------------------------------------------------
+struct adc_stream *adc_stream_start (adc_board_t *b, adc_pin_t pin, struct adc_ring *r)
+{
+    struct adc_stream *st;
+    int active;
+
+    if ((b == NULL) || (r == NULL) || (r->buf == NULL) || (pin >= ADC_CHIP_CNT * ADC_CH_CNT))
+        return NULL;
+
+    pthread_mutex_lock(&b->lock);
+    active = CHIP_ACTIVE(b, pin / ADC_CH_CNT) ? 1 : 0;
+    pthread_mutex_unlock(&b->lock);
+    if (!active)
+        return NULL;
+
+    if ((st = calloc(1, sizeof(struct adc_stream))) == NULL)
+        return NULL;
+
+    st->board   = b;
+    st->adc_idx = pin / ADC_CH_CNT;
+    st->ch_idx  = pin % ADC_CH_CNT;
+    st->ring    = r;
+    atomic_init(&st->run, 1);
+
+    if (pthread_create(&st->thread, NULL, stream_thread, st)) {
+        free (st);
+        return NULL;
+    }
+    return st;
+}
+
+//------------------------------------------------------------------------------
+// stream thread 종료. return : 변환한 sample 수, -1 : bus error로 중단됨
+//------------------------------------------------------------------------------
+int adc_stream_stop (struct adc_stream *st)
+{
+    int ret;
+
+    if (st == NULL)
+        return -1;
+
+    atomic_store(&st->run, 0);
+    pthread_join(st->thread, NULL);
+
+    ret = st->error ? -1 : (int)st->count;
+    free (st);
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
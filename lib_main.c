@@ -29,6 +29,7 @@
 #include <sys/mman.h>
 #include <linux/fb.h>
 #include <getopt.h>
+#include <signal.h>
 
 #include "lib_i2cadc.h"
 
@@ -40,13 +41,36 @@
 static void print_usage (const char *prog)
 {
     puts("");
-    printf("Usage: %s [-D:device] [-p:pin name] [-v]\n", prog);
+    printf("Usage: %s [-D:device] [-p:pin name] [-v] [-s] [-d:period us] [-S:shm name]\n"
+           "       [-R:record file] [-z] [-r:replay file] [-t:start sec] [-B:board file]\n"
+           "       [-m:interval us] [-o:csv|bin]\n", prog);
     puts("\n"
          "  -D --Device         Control Device node(i2c dev)\n"
          "  -p --pin name       Header pin name in adc board (con1, con1.1...)\n"
          "  -v --view all port  ALL Haader pin info display.\n"
+         "  -s --stats          Bus statistics display. (build with __LIB_I2CADC_STATS__)\n"
+         "  -d --daemon         Publish board snapshot to shared memory every period us.\n"
+         "  -S --shm            Shared memory name (default " ADC_SHM_NAME ").\n"
+         "                      Without -D, -p/-v read the snapshot from shared memory.\n"
+         "  -R --record         Record snapshot to binary log file (period : -d, default 1000 us).\n"
+         "  -z --delta          Record with delta frames (smaller file).\n"
+         "  -r --replay         Replay binary log file. (-p pin values, -t start offset in sec)\n"
+         "  -B --board          Board description file (chip address, header pin map).\n"
+         "                      Default : built-in ODROID-JIG ADC board.\n"
+         "  -m --monitor        Continuous monitor every interval us. (-p header/pin, default all)\n"
+         "                      Only changed values are redrawn. Without -D, reads shared memory.\n"
+         "  -o --output         Monitor output to stdout instead of the screen.\n"
+         "                      csv : time(sec) + pin mV per line (error sample = empty)\n"
+         "                      bin : binary capture log (-z delta, replay with -r, needs -D)\n"
          "\n"
          "  e.g) ./lib_i2cadc -D /dev/i2c-0 -p con1.1\n"
+         "       ./lib_i2cadc -D /dev/i2c-0 -d 10000 &\n"
+         "       ./lib_i2cadc -v\n"
+         "       ./lib_i2cadc -D /dev/i2c-0 -R burnin.bin -z\n"
+         "       ./lib_i2cadc -r burnin.bin -p con1 -t 3600\n"
+         "       ./lib_i2cadc -D /dev/i2c-0 -B jig_rev2.board -v\n"
+         "       ./lib_i2cadc -D /dev/i2c-0 -m 100000 -p con1\n"
+         "       ./lib_i2cadc -D /dev/i2c-0 -m 1000 -o csv > soak.csv\n"
          "\n"
     );
     exit(1);
@@ -58,6 +82,18 @@ static void print_usage (const char *prog)
 static char *OPT_DEVICE_NODE    = NULL;
 static char *OPT_PIN_NAME       = NULL;
 static char  OPT_VIEW_INFO      = 0;
+static char  OPT_VIEW_STATS     = 0;
+static int   OPT_DAEMON_US      = 0;
+static char *OPT_SHM_NAME       = ADC_SHM_NAME;
+static char *OPT_RECORD_FILE    = NULL;
+static char  OPT_RECORD_DELTA   = 0;
+static char *OPT_REPLAY_FILE    = NULL;
+static int   OPT_REPLAY_SEC     = 0;
+static char *OPT_BOARD_FILE     = NULL;
+static int   OPT_MONITOR_US     = 0;
+static char *OPT_OUTPUT         = NULL;
+
+static volatile sig_atomic_t DaemonRun = 1;
 
 //------------------------------------------------------------------------------
 // 문자열 변경 함수. 입력 포인터는 반드시 메모리가 할당되어진 변수여야 함.
@@ -87,11 +123,21 @@ static void parse_opts (int argc, char *argv[])
             { "Device",     1, 0, 'D' },
             { "read_word",  1, 0, 'p' },
             { "read_byte",  0, 0, 'v' },
+            { "stats",      0, 0, 's' },
+            { "daemon",     1, 0, 'd' },
+            { "shm",        1, 0, 'S' },
+            { "record",     1, 0, 'R' },
+            { "delta",      0, 0, 'z' },
+            { "replay",     1, 0, 'r' },
+            { "time",       1, 0, 't' },
+            { "board",      1, 0, 'B' },
+            { "monitor",    1, 0, 'm' },
+            { "output",     1, 0, 'o' },
             { NULL, 0, 0, 0 },
         };
         int c;
 
-        c = getopt_long(argc, argv, "D:p:vh", lopts, NULL);
+        c = getopt_long(argc, argv, "D:p:vsd:S:R:zr:t:B:m:o:h", lopts, NULL);
 
         if (c == -1)
             break;
@@ -108,6 +154,47 @@ static void parse_opts (int argc, char *argv[])
         case 'v':
             OPT_VIEW_INFO = 1;
             break;
+        /* Bus statistics view */
+        case 's':
+            OPT_VIEW_STATS = 1;
+            break;
+        /* Shared memory publication */
+        case 'd':
+            OPT_DAEMON_US = atoi(optarg);
+            if (OPT_DAEMON_US <= 0)
+                print_usage(argv[0]);
+            break;
+        case 'S':
+            OPT_SHM_NAME = optarg;
+            break;
+        /* Binary capture log */
+        case 'R':
+            OPT_RECORD_FILE = optarg;
+            break;
+        case 'z':
+            OPT_RECORD_DELTA = 1;
+            break;
+        case 'r':
+            OPT_REPLAY_FILE = optarg;
+            break;
+        case 't':
+            OPT_REPLAY_SEC = atoi(optarg);
+            break;
+        /* Board description */
+        case 'B':
+            OPT_BOARD_FILE = optarg;
+            break;
+        /* Continuous monitor */
+        case 'm':
+            OPT_MONITOR_US = atoi(optarg);
+            if (OPT_MONITOR_US <= 0)
+                print_usage(argv[0]);
+            break;
+        case 'o':
+            OPT_OUTPUT = optarg;
+            if (strcmp(OPT_OUTPUT, "csv") && strcmp(OPT_OUTPUT, "bin"))
+                print_usage(argv[0]);
+            break;
         case 'h':
         default:
             print_usage(argv[0]);
@@ -117,14 +204,21 @@ static void parse_opts (int argc, char *argv[])
 }
 
 //------------------------------------------------------------------------------------------------------------
-int print_pin_info (int fd, const char *h_name)
+// snap == NULL이면 adc board에서 직접 읽고, 그렇지 않으면 snapshot 데이터를 사용함.
+//------------------------------------------------------------------------------------------------------------
+int print_pin_info (int fd, const struct adc_snapshot *snap, const char *h_name)
 {
-    int r_pin_mv[100], r_pin_cnt = 0, i;
+    int r_pin_mv[100], r_pin_cnt = 0, i, ret;
 
     if (h_name == NULL)
         return -1;
 
-    if (adc_board_read   (fd, h_name, r_pin_mv, &r_pin_cnt)) {
+    if (snap)
+        ret = adc_snapshot_read (snap, h_name, r_pin_mv, &r_pin_cnt);
+    else
+        ret = adc_board_read    (fd, h_name, r_pin_mv, &r_pin_cnt);
+
+    if (ret > 0) {
         if (r_pin_cnt) {
             printf ("%10s\t%s\n", "PIN Name","mV");
             printf ("--------------------------\n");
@@ -143,40 +237,532 @@ int print_pin_info (int fd, const char *h_name)
 }
 
 //------------------------------------------------------------------------------------------------------------
-void print_all_info (int fd)
+// 보드 전체를 1회 sampling(snapshot)한 후 모든 header 정보를 출력함.
+//------------------------------------------------------------------------------------------------------------
+void print_all_info (int fd, const struct adc_snapshot *shm_snap)
+{
+    struct adc_snapshot snap;
+    const char *h_name;
+    int i;
+
+    if (shm_snap)
+        snap = *shm_snap;
+    else if (adc_board_snapshot (adc_board_get (fd), &snap) < 0)
+        return;
+
+    for (i = 0; (h_name = adc_desc_header (i)) != NULL; i++)
+        print_pin_info(fd, &snap, h_name);
+}
+
+//------------------------------------------------------------------------------------------------------------
+// recovery 상태, bus 통계 출력. latency histogram은 0이 아닌 bin만 출력함. (bin n : 2^n ~ 2^(n+1) ns)
+//------------------------------------------------------------------------------------------------------------
+void print_stats (int fd)
+{
+    static const char *op_name[ADC_OP_CNT] = { "set_addr", "smbus", "rdwr", "plain", "lookup" };
+    struct adc_bus_stats st;
+    struct adc_health h;
+    int i, n;
+
+    // recovery 상태는 항상 출력
+    if (adc_board_health (adc_board_get (fd), &h, 0) == 0) {
+        printf ("recovery : retries = %llu, isolated = 0x%02X, isolations = %llu, restores = %llu, "
+                "bus_recover = %llu (fail %llu)\n",
+            h.retries, h.isolated, h.isolations, h.restores, h.bus_recover, h.bus_recover_fail);
+        printf ("failed chip scan =");
+        for (i = 0; i < ADC_CHIP_CNT; i++)
+            printf (" %llu", h.failed[i]);
+        printf ("\n");
+    }
+
+    if (adc_board_stats (adc_board_get (fd), &st, 0) < 0) {
+        printf ("bus statistics not available (build with __LIB_I2CADC_STATS__)\n");
+        return;
+    }
+
+    printf ("transaction = %llu, bytes = %llu, addr_switch = %llu, retry = %llu\n",
+        st.trans, st.bytes, st.addr_switch, st.retry);
+    printf ("error : bus = %llu, chip =", st.err_bus);
+    for (i = 0; i < ADC_CHIP_CNT; i++)
+        printf (" %llu", st.err[i]);
+    printf ("\n");
+
+    printf ("%10s\t%8s\t%10s\t%s\n", "op", "count", "avg(ns)", "log2(ns):count");
+    printf ("--------------------------------------------------------------\n");
+    for (i = 0; i < ADC_OP_CNT; i++) {
+        if (!st.op[i])
+            continue;
+        printf ("%10s\t%8llu\t%10llu\t", op_name[i], st.op[i], st.op_ns[i] / st.op[i]);
+        for (n = 0; n < ADC_HIST_BINS; n++)
+            if (st.hist[i][n])
+                printf ("%d:%u ", n, st.hist[i][n]);
+        printf ("\n");
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------
+static void daemon_signal (int sig)
+{
+    (void)sig;
+    DaemonRun = 0;
+}
+
+//------------------------------------------------------------------------------------------------------------
+// 다음 주기(period_us)의 deadline. 이미 지난 경우(terminal 정지, pipe 지연 등) 밀린 주기를
+// 연속으로 실행하지 않도록 현재 시간 기준으로 다시 시작함. (clock_nanosleep은 지난 시간에 0)
+//------------------------------------------------------------------------------------------------------------
+static void next_deadline (struct timespec *ts, int period_us)
+{
+    struct timespec now;
+
+    ts->tv_nsec += (period_us % 1000000) * 1000;
+    ts->tv_sec  += period_us / 1000000 + ts->tv_nsec / 1000000000;
+    ts->tv_nsec %= 1000000000;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if ((ts->tv_sec < now.tv_sec) || ((ts->tv_sec == now.tv_sec) && (ts->tv_nsec < now.tv_nsec)))
+        *ts = now;
+}
+
+#define DAEMON_FAIL_MAX     100     // 시작 후 연속으로 유효한 snapshot이 없는 횟수. 초과시 종료
+
+//------------------------------------------------------------------------------------------------------------
+// daemon mode : period_us마다 snapshot을 shared memory에 게시(shm_name)하거나 binary log file에
+// 기록(log_file)함. (SIGINT/SIGTERM으로 종료)
+// client는 -S name 또는 adc_shm_open()으로 bus 접근 없이 읽음.
+// 시작 후 DAEMON_FAIL_MAX회 연속으로 유효한 snapshot이 없으면 종료하며, 이후의 실패/복구는
+// stderr로 알림.
+//------------------------------------------------------------------------------------------------------------
+int sample_daemon (int fd, int period_us, const char *shm_name, const char *log_file)
+{
+    struct adc_snapshot snap;
+    struct adc_shm *shm = NULL;
+    struct adc_log *log = NULL;
+    struct timespec ts;
+    adc_board_t *b = adc_board_get (fd);
+    unsigned long long published = 0;
+    int ret = 0, snap_ret, fails = 0;
+
+    // shared memory를 만들기 전에 board 확인 (client가 게시되지 않는 segment를 기다리지 않도록)
+    if (b == NULL) {
+        fprintf (stderr, "%s : adc board(fd %d) is not opened\n", __func__, fd);
+        return -1;
+    }
+
+    if (shm_name && ((shm = adc_shm_create (shm_name, period_us)) == NULL))
+        return -1;
+
+    if (log_file && ((log = adc_log_create (b, log_file, OPT_RECORD_DELTA ? ADC_LOG_DELTA : 0)) == NULL)) {
+        adc_shm_close (shm);
+        return -1;
+    }
+
+    signal(SIGINT,  daemon_signal);
+    signal(SIGTERM, daemon_signal);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    while (DaemonRun) {
+        if ((snap_ret = adc_board_snapshot (b, &snap)) > 0) {
+            if (shm)
+                adc_shm_publish (shm, &snap);
+            if (log && adc_log_append (log, &snap)) {
+                fprintf (stderr, "%s : write error : %s\n", log_file, strerror(errno));
+                ret = -1;
+                break;
+            }
+            if (fails >= DAEMON_FAIL_MAX)
+                fprintf (stderr, "%s : snapshot recovered\n", __func__);
+            published++;
+            fails = 0;
+        }
+        else if (snap_ret < 0 || ++fails == DAEMON_FAIL_MAX) {
+            fprintf (stderr, "%s : no valid snapshot (%d times)%s\n", __func__, fails,
+                (snap_ret < 0 || !published) ? ", exit" : "");
+            if ((snap_ret < 0) || !published) {
+                ret = -1;
+                break;
+            }
+        }
+
+        next_deadline (&ts, period_us);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    if (log && adc_log_close (log))
+        ret = -1;
+    adc_shm_close (shm);
+    return ret;
+}
+
+//------------------------------------------------------------------------------------------------------------
+// replay mode : log 정보 출력. h_name이 있으면 start_sec 이후의 header/pin 값(mV)을 frame마다 출력함.
+//------------------------------------------------------------------------------------------------------------
+int log_replay (const char *fname, const char *h_name, int start_sec)
+{
+    unsigned long long first, last;
+    struct adc_snapshot snap;
+    int mv[100], cnt, i;
+    struct adc_log *log;
+
+    if ((log = adc_log_open (fname)) == NULL)
+        return -1;
+
+    if (adc_log_range (log, &first, &last)) {
+        printf ("%s : no frame\n", fname);
+        adc_log_close (log);
+        return -1;
+    }
+    printf ("%s : %.3f sec (%llu ~ %llu ns)\n", fname, (last - first) / 1e9, first, last);
+
+    if (h_name && (adc_log_seek (log, first + start_sec * 1000000000ULL) > 0)) {
+        while (adc_log_next (log, &snap) > 0) {
+            if (adc_snapshot_read (&snap, h_name, mv, &cnt) <= 0) {
+                printf ("can't found %s pin or header\n", h_name);
+                break;
+            }
+            printf ("%12.6f", (snap.ts_ns - first) / 1e9);
+            for (i = 0; i < cnt; i++)
+                printf (" %d", mv[i]);
+            printf ("\n");
+        }
+    }
+    adc_log_close (log);
+    return 0;
+}
+
+//------------------------------------------------------------------------------------------------------------
+// monitor mode : 화면의 cell(header pin) 위치와 마지막 출력값. frame은 buffer에 만든 후 1회 write 함.
+//------------------------------------------------------------------------------------------------------------
+#define MON_CELL_MAX    1024
+#define MON_COLS        8           // 줄당 pin 수
+#define MON_BUF_SIZE    (MON_CELL_MAX * 24 + 256)
+#define MON_FAIL_MAX    100         // 연속 snapshot error(-1) 수. 초과시 monitor 종료
+
+struct mon_cell {
+    adc_pin_t           pin;
+    char                name [24];      // header.pin (csv column)
+    short               row, col;
+    int                 mv;
+    unsigned char       flags;
+};
+
+struct mon_buf {
+    char                p [MON_BUF_SIZE];
+    int                 len;
+};
+
+static struct mon_cell  MonCell [MON_CELL_MAX];
+static struct mon_buf   MonBuf;
+
+//------------------------------------------------------------------------------------------------------------
+static void mon_printf (struct mon_buf *f, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if (f->len >= MON_BUF_SIZE)
+        return;
+
+    va_start(ap, fmt);
+    n = vsnprintf(f->p + f->len, MON_BUF_SIZE - f->len, fmt, ap);
+    va_end(ap);
+    f->len = ((n < 0) || (f->len + n >= MON_BUF_SIZE)) ? MON_BUF_SIZE - 1 : f->len + n;
+}
+
+//------------------------------------------------------------------------------------------------------------
+static int mon_flush (struct mon_buf *f)
+{
+    const char *p = f->p;
+    int len = f->len, ret;
+
+    while (len > 0) {
+        if ((ret = write(STDOUT_FILENO, p, len)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += ret, len -= ret;
+    }
+    f->len = 0;
+    return 0;
+}
+
+//------------------------------------------------------------------------------------------------------------
+// cell 배치. h_name != NULL이면 해당 header/pin만, 아니면 모든 header. return : cell 수
+// draw != 0 이면 고정 문자(header name, pin 번호)를 buffer에 출력함.
+// 화면은 1줄 상태 표시 + header별 MON_COLS pin 씩 (pin 번호 3자 + mV 6자)
+//------------------------------------------------------------------------------------------------------------
+static int mon_layout (const char *h_name, int draw)
+{
+    adc_pin_t pins [ADC_HEADER_PINS];
+    const char *name;
+    int i, h, n, cnt = 0, row = 3;
+
+    for (h = 0; cnt < MON_CELL_MAX; h++) {
+        if ((name = h_name ? h_name : adc_desc_header (h)) == NULL)
+            break;
+        if ((n = adc_pin_resolve (name, pins, ADC_HEADER_PINS)) > 0) {
+            n = (n > ADC_HEADER_PINS) ? ADC_HEADER_PINS : n;
+            if (draw)
+                mon_printf (&MonBuf, "\033[%d;1H%-10s", row, name);
+
+            for (i = 0; (i < n) && (cnt < MON_CELL_MAX); i++, cnt++) {
+                MonCell[cnt].pin   = pins[i];
+                MonCell[cnt].row   = row + i / MON_COLS;
+                MonCell[cnt].col   = 11 + (i % MON_COLS) * 11;
+                MonCell[cnt].mv    = INT_MIN;
+                MonCell[cnt].flags = 0;
+                // 같은 pin handle이 여러 header에 있을 수 있으므로 header 기준 이름 사용
+                if (n > 1)
+                    snprintf(MonCell[cnt].name, sizeof(MonCell[cnt].name), "%s.%d", name, i + 1);
+                else
+                    snprintf(MonCell[cnt].name, sizeof(MonCell[cnt].name), "%s", name);
+                if (!draw)
+                    continue;
+                mon_printf (&MonBuf, "\033[%d;%dH%2d:", MonCell[cnt].row, MonCell[cnt].col, i + 1);
+                if (pins[i] == ADC_PIN_NC)
+                    mon_printf (&MonBuf, "%6s", "-");
+            }
+            row += (n + MON_COLS - 1) / MON_COLS;
+        }
+        if (h_name)
+            break;
+    }
+    return cnt;
+}
+
+//------------------------------------------------------------------------------------------------------------
+// 화면에 변경된 cell만 다시 출력함. (bus error 등 유효하지 않은 sample = ERR)
+//------------------------------------------------------------------------------------------------------------
+static void mon_draw (const struct adc_snapshot *snap, int cells)
+{
+    struct mon_cell *c;
+    unsigned char flags;
+    int i, mv;
+
+    for (i = 0; i < cells; i++) {
+        if ((c = &MonCell[i])->pin == ADC_PIN_NC)
+            continue;
+
+        mv    = adc_snapshot_pin (snap, c->pin);
+        flags = snap->flags[c->pin / ADC_CH_CNT][c->pin % ADC_CH_CNT] & ADC_FLAG_INVALID;
+        if ((mv == c->mv) && (flags == c->flags))
+            continue;
+
+        c->mv = mv, c->flags = flags;
+        mon_printf (&MonBuf, "\033[%d;%dH", c->row, c->col + 3);
+        if (flags)
+            mon_printf (&MonBuf, "%6s", "ERR");
+        else
+            mon_printf (&MonBuf, "%6d", mv);
+    }
+}
+
+//------------------------------------------------------------------------------------------------------------
+// csv 1줄 (time, pin mV ...). first != 0 이면 column 이름 줄을 먼저 출력함.
+//------------------------------------------------------------------------------------------------------------
+static void mon_csv (const struct adc_snapshot *snap, int cells, unsigned long long t0, int first)
+{
+    adc_pin_t pin;
+    int i;
+
+    if (first) {
+        mon_printf (&MonBuf, "time");
+        for (i = 0; i < cells; i++)
+            if (MonCell[i].pin != ADC_PIN_NC)
+                mon_printf (&MonBuf, ",%s", MonCell[i].name);
+        mon_printf (&MonBuf, "\n");
+    }
+    mon_printf (&MonBuf, "%.6f", (snap->ts_ns - t0) / 1e9);
+    for (i = 0; i < cells; i++) {
+        if ((pin = MonCell[i].pin) == ADC_PIN_NC)
+            continue;
+        if (snap->flags[pin / ADC_CH_CNT][pin % ADC_CH_CNT] & ADC_FLAG_INVALID)
+            mon_printf (&MonBuf, ",");
+        else
+            mon_printf (&MonBuf, ",%d", adc_snapshot_pin (snap, pin));
+    }
+    mon_printf (&MonBuf, "\n");
+}
+
+//------------------------------------------------------------------------------------------------------------
+// monitor mode : interval_us마다 board를 1회 sampling(snapshot)하여 화면 또는 csv로 출력함.
+// board(fd)는 종료시까지 열린 상태로 사용하며 fd < 0 이면 shared memory(shm_name)에서 읽음.
+// snapshot error(-1)가 MON_FAIL_MAX회 연속되면 종료함. (SIGINT/SIGTERM으로 종료)
+//------------------------------------------------------------------------------------------------------------
+int monitor (int fd, int interval_us, const char *h_name, const char *shm_name, int csv)
+{
+    struct adc_snapshot snap;
+    struct adc_shm *shm = NULL;
+    struct timespec ts, t_scan;
+    unsigned long long t0 = 0, frames = 0, scan_ns;
+    unsigned int seq = 0;
+    adc_board_t *b = NULL;
+    const char *msg;
+    int cells, ret = 0, last = 1, fails = 0;
+
+    if ((fd < 0) && ((shm = adc_shm_open (shm_name)) == NULL))
+        return -1;
+    if ((fd >= 0) && ((b = adc_board_get (fd)) == NULL)) {
+        fprintf (stderr, "%s : adc board(fd %d) is not opened\n", __func__, fd);
+        return -1;
+    }
+
+    signal(SIGINT,  daemon_signal);
+    signal(SIGTERM, daemon_signal);
+
+    // 화면 지우기, cursor 숨김
+    if (!csv)
+        mon_printf (&MonBuf, "\033[2J\033[?25l");
+    if ((cells = mon_layout (h_name, !csv)) <= 0) {
+        printf ("can't found %s pin or header\n", h_name ? h_name : "");
+        adc_shm_close (shm);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    while (DaemonRun) {
+        clock_gettime(CLOCK_MONOTONIC, &t_scan);
+        if (shm)
+            ret = adc_shm_snapshot (shm, &snap);
+        else
+            ret = adc_board_snapshot (b, &snap);
+        scan_ns = (unsigned long long)t_scan.tv_sec * 1000000000ULL + t_scan.tv_nsec;
+        clock_gettime(CLOCK_MONOTONIC, &t_scan);
+        scan_ns = (unsigned long long)t_scan.tv_sec * 1000000000ULL + t_scan.tv_nsec - scan_ns;
+
+        // 새로운 snapshot만 출력 (shared memory는 writer 주기가 다를 수 있음)
+        if ((ret > 0) && (shm == NULL || snap.seq != seq)) {
+            seq = snap.seq;
+            if (!frames++)
+                t0 = snap.ts_ns;
+            if (csv)
+                mon_csv (&snap, cells, t0, frames == 1);
+            else {
+                mon_printf (&MonBuf, "\033[1;1H%s  interval %d us  frame %llu  scan %llu us\033[K",
+                    shm ? shm_name : OPT_DEVICE_NODE, interval_us, frames, scan_ns / 1000);
+                mon_draw (&snap, cells);
+            }
+        }
+        // 출력할 snapshot이 없음. 상태가 바뀐 경우에만 표시 (csv는 stdout을 사용하므로 stderr)
+        else if ((ret <= 0) && (ret != last)) {
+            msg = (ret < 0) ? "snapshot error" : shm ? "snapshot not published yet" : "no valid sample";
+            if (csv)
+                fprintf (stderr, "%s : %s\n", __func__, msg);
+            else
+                mon_printf (&MonBuf, "\033[1;1H%s  %s\033[K", shm ? shm_name : OPT_DEVICE_NODE, msg);
+        }
+        fails = (ret < 0) ? fails + 1 : 0;
+        last  = ret;
+        if (mon_flush (&MonBuf)) {
+            ret = -1;
+            break;
+        }
+        if (fails >= MON_FAIL_MAX) {
+            fprintf (stderr, "%s : snapshot error %d times, exit\n", __func__, fails);
+            break;
+        }
+        ret = 0;
+
+        // 늦은 경우 현재 시간 기준으로 다시 시작 (next_deadline)
+        next_deadline (&ts, interval_us);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    // cursor 복원 (마지막 줄 다음으로 이동)
+    if (!csv) {
+        mon_printf (&MonBuf, "\033[%d;1H\033[?25h\n", MonCell[cells - 1].row + 2);
+        mon_flush (&MonBuf);
+    }
+    adc_shm_close (shm);
+    return ret;
+}
+
+//------------------------------------------------------------------------------------------------------------
+// client mode : daemon이 게시한 snapshot을 출력함.
+//------------------------------------------------------------------------------------------------------------
+int shm_client (const char *name)
 {
-    print_pin_info(fd, "CON1");
-    print_pin_info(fd, "P3");
-    print_pin_info(fd, "P13");
-    print_pin_info(fd, "P1_1");
-    print_pin_info(fd, "P1_2");
-    print_pin_info(fd, "P1_3");
-    print_pin_info(fd, "P1_4");
-    print_pin_info(fd, "P1_5");
-    print_pin_info(fd, "P1_6");
+    struct adc_snapshot snap;
+    struct adc_shm *shm;
+    int ret;
+
+    if ((shm = adc_shm_open (name)) == NULL)
+        return -1;
+
+    if ((ret = adc_shm_snapshot (shm, &snap)) > 0) {
+        if (OPT_VIEW_INFO)
+            print_all_info (-1, &snap);
+        if (OPT_PIN_NAME)
+            print_pin_info (-1, &snap, OPT_PIN_NAME);
+    }
+    else
+        printf ("%s : snapshot not published yet\n", name);
+
+    adc_shm_close (shm);
+    return (ret > 0) ? 0 : -1;
 }
 
 //------------------------------------------------------------------------------------------------------------
 //------------------------------------------------------------------------------------------------------------
 int main (int argc, char *argv[])
 {
-    int fd;
+    int fd, i;
 
     parse_opts(argc, argv);
 
-    if (OPT_DEVICE_NODE == NULL)
+    if (OPT_BOARD_FILE && (adc_desc_load (OPT_BOARD_FILE) < 0))
+        return -1;
+
+    if (OPT_REPLAY_FILE)
+        return log_replay (OPT_REPLAY_FILE, OPT_PIN_NAME, OPT_REPLAY_SEC);
+
+    if (OPT_OUTPUT && !OPT_MONITOR_US)
         print_usage(argv[0]);
 
-    if ((fd = adc_board_init (OPT_DEVICE_NODE)) < 0)
+    if (OPT_DEVICE_NODE == NULL) {
+        if (OPT_MONITOR_US) {
+            if (OPT_OUTPUT && !strcmp(OPT_OUTPUT, "bin"))
+                print_usage(argv[0]);
+            return monitor (-1, OPT_MONITOR_US, OPT_PIN_NAME, OPT_SHM_NAME, OPT_OUTPUT != NULL);
+        }
+        if (OPT_DAEMON_US || OPT_RECORD_FILE || (!OPT_VIEW_INFO && !OPT_PIN_NAME))
+            print_usage(argv[0]);
+        return shm_client (OPT_SHM_NAME);
+    }
+
+    // adc_board_init은 open 실패시 0, probe 실패시 -1
+    if ((fd = adc_board_init (OPT_DEVICE_NODE)) <= 0) {
+        if (!fd)
+            printf ("Can not open i2c_dev = %s\n", OPT_DEVICE_NODE);
         return -1;
+    }
+
+    // monitor mode : board를 열어둔 상태로 계속 sampling (bin은 capture log를 stdout으로 기록)
+    if (OPT_MONITOR_US) {
+        if (OPT_OUTPUT && !strcmp(OPT_OUTPUT, "bin"))
+            i = sample_daemon (fd, OPT_MONITOR_US, NULL, "/dev/stdout");
+        else
+            i = monitor (fd, OPT_MONITOR_US, OPT_PIN_NAME, NULL, OPT_OUTPUT != NULL);
+        adc_board_deinit (fd);
+        return i;
+    }
+
+    if (OPT_DAEMON_US || OPT_RECORD_FILE) {
+        i = sample_daemon (fd, OPT_DAEMON_US ? OPT_DAEMON_US : 1000,
+                           OPT_DAEMON_US ? OPT_SHM_NAME : NULL, OPT_RECORD_FILE);
+        adc_board_deinit (fd);
+        return i;
+    }
 
     if (OPT_VIEW_INFO)
-        print_all_info (fd);
+        print_all_info (fd, NULL);
 
     if (OPT_PIN_NAME)
-        print_pin_info (fd, OPT_PIN_NAME);
+        print_pin_info (fd, NULL, OPT_PIN_NAME);
+
+    if (OPT_VIEW_STATS)
+        print_stats (fd);
 
-    close(fd);
+    adc_board_deinit (fd);
 
     return 0;
 }